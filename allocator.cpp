@@ -1,521 +1,3622 @@
-/*
- * Memory Allocator Implementation (C++)
- *
- * This file implements malloc and free using an explicit free list.
- *
- * BLOCK STRUCTURE:
- * - Every block has a header and footer containing size and allocated bit
- * - Free blocks store next and prev pointers in the payload area
- * - Minimum block size on 64-bit systems is 24 bytes:
- *     header(4) + next ptr(8) + prev ptr(8) + footer(4) = 24 bytes
- *   The split threshold in place() accounts for this (see MIN_BLOCK_SIZE below)
- * - All blocks are 8-byte aligned
- *
- * FREE LIST STRUCTURE:
- * - Explicit doubly-linked list of free blocks
- * - LIFO policy (insert freed blocks at the head)
- * - nullptr-terminated (no sentinel node)
- * - free_listp points to the head of the list, or nullptr if empty
- *
- * C++ USAGE NOTES:
- * - Use modern C++ features where helpful (nullptr, references, constexpr)
- * - DO NOT use new/delete (infinite recursion -- they call malloc!)
- * - DO NOT use STL containers (they call malloc internally!)
- * - DO NOT use smart pointers
- * - Pointer arithmetic and casts are necessary for this low-level code
- */
-
-#include <cstdio>
-#include <cstdlib>
-#include <cassert>
-#include <cstring>
-#include "allocator.h"
-#include "memlib.h"
-
-/* ============================================
- * Constants
- *
- * Integer constants can and should be constexpr in C++ -- it gives
- * type safety and lets the compiler catch mistakes that #define cannot.
- *
- * The pointer-manipulating macros below (HDRP, FTRP, GET, PUT, etc.)
- * cannot be constexpr because they dereference runtime addresses.
- * That is why those remain as #define macros rather than constexpr.
- * ============================================ */
-
-constexpr size_t WSIZE     = 4;          /* Word size in bytes              */
-constexpr size_t DSIZE     = 8;          /* Double word size in bytes       */
-constexpr size_t CHUNKSIZE = (1 << 12);  /* Default heap extension size 4KB */
-
-/*
- * Minimum free block size.
- * A free block must hold: header(4) + next ptr + prev ptr + footer(4).
- * On a 64-bit system sizeof(void*) == 8, so the minimum is 4+8+8+4 = 24 bytes.
- * We round up to the next multiple of DSIZE to preserve alignment → 24 bytes.
- * Use this as the split threshold in place() rather than 2*DSIZE (16), which
- * would be too small to store the two free-list pointers.
- */
-constexpr size_t MIN_BLOCK_SIZE = DSIZE + 2 * sizeof(void *); /* 24 on 64-bit */
-
-/* ============================================
- * Macros
- * ============================================ */
-
-/* Pack a size and allocated bit into a single word */
-#define PACK(size, alloc)  ((size) | (alloc))
-
-/* Read and write a 4-byte word at address p */
-#define GET(p)       (*(unsigned int *)(p))
-#define PUT(p, val)  (*(unsigned int *)(p) = (val))
-
-/* Extract size and allocated bit from a header/footer word at address p */
-#define GET_SIZE(p)   (GET(p) & ~0x7)
-#define GET_ALLOC(p)  (GET(p) & 0x1)
-
-/* Given a block payload pointer bp, compute address of its header and footer */
-#define HDRP(bp)  ((char *)(bp) - WSIZE)
-#define FTRP(bp)  ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
-
-/* Given a block payload pointer bp, compute payload pointer of adjacent blocks */
-#define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(HDRP(bp)))
-#define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE((char *)(bp) - DSIZE))
-
-/* ============================================
- * Free list pointer macros
- *
- * Free blocks store a next and prev pointer inside their payload:
- *
- *   [Header 4B][Next sizeof(void*)][Prev sizeof(void*)][...][Footer 4B]
- *              ^bp                  ^bp + sizeof(void*)
- *
- * GET_NEXT_FREE / GET_PREV_FREE dereference those memory locations,
- * which produces an lvalue (a location you can assign to). That is
- * why SET_NEXT_FREE / SET_PREV_FREE can write through those same
- * expressions: assigning to a dereferenced pointer writes to the
- * underlying memory. This is standard C++ -- not a trick.
- *
- * We use sizeof(void*) rather than DSIZE for the prev offset so the
- * code is correct on both 32-bit (sizeof(void*)==4) and 64-bit
- * (sizeof(void*)==8) platforms. On a 64-bit machine these happen to
- * be equal, but being explicit avoids a silent bug on 32-bit.
- * ============================================ */
-#define GET_NEXT_FREE(bp)       (*(void **)(bp))
-#define GET_PREV_FREE(bp)       (*(void **)((char *)(bp) + sizeof(void *)))
-#define SET_NEXT_FREE(bp, val)  (*(void **)(bp) = (val))
-#define SET_PREV_FREE(bp, val)  (*(void **)((char *)(bp) + sizeof(void *)) = (val))
-
-/* ============================================
- * Global Variables
- * ============================================ */
-
-/* Points to the payload of the prologue block (fixed anchor at heap start) */
-static char *heap_listp = nullptr;
-
-/* Points to the first block in the explicit free list, or nullptr if empty */
-static char *free_listp = nullptr;
-
-/* ============================================
- * Helper Function Prototypes
- * ============================================ */
-
-static void *extend_heap(size_t words);
-static void *coalesce(void *bp);
-static void *find_fit(size_t asize);
-static void  place(void *bp, size_t asize);
-static void  add_to_free_list(void *bp);
-static void  remove_from_free_list(void *bp);
-
-/* ============================================
- * Main Allocator Functions
- * ============================================ */
-
-/*
- * mm_init - Initialize the memory allocator.
- *
- * TODO: Implement this function.
- *
- * Creates the initial empty heap with a prologue and epilogue block.
- * These sentinel blocks prevent special-case code in coalesce():
- * the prologue ensures we never coalesce past the heap start, and
- * the epilogue ensures we never coalesce past the heap end.
- *
- * Required heap layout after mm_init:
- *
- *   Offset:  0      4      8      12
- *            +------+------+------+------+
- *   Content: | Pad  |ProHdr|ProFtr|EpiHdr|
- *            |  0   | 8|1  | 8|1  |  0|1 |
- *            +------+------+------+------+
- *                          ^
- *                      heap_listp points HERE
- *                      (prologue payload: between header and footer)
- *
- * Prologue: size=DSIZE (8), allocated=1
- * Epilogue: size=0,         allocated=1
- *
- * Steps:
- * 1. Call mem_sbrk(4 * WSIZE). Return -1 immediately if it fails.
- * 2. Write four words at the returned address:
- *      [0]: padding word, value 0
- *      [1]: prologue header, PACK(DSIZE, 1)
- *      [2]: prologue footer, PACK(DSIZE, 1)
- *      [3]: epilogue header, PACK(0, 1)
- * 3. Set heap_listp to point to the prologue payload:
- *      heap_listp = <returned address> + 2*WSIZE
- *    This places heap_listp between the prologue header and footer.
- * 4. Set free_listp = nullptr  (no free blocks yet).
- * 5. Call extend_heap(CHUNKSIZE / WSIZE). Return -1 if it fails.
- *
- * Return: 0 on success, -1 on error.
- */
-int mm_init(void) {
-    /* Request 4 words from the memory system */
-    if ((heap_listp = (char*)mem_sbrk(4 * WSIZE)) == (char*)-1) return -1;
-
-    PUT(heap_listp, 0);                          /* Alignment padding */
-    PUT(heap_listp + (1 * WSIZE), PACK(DSIZE, 1)); /* Prologue header */
-    PUT(heap_listp + (2 * WSIZE), PACK(DSIZE, 1)); /* Prologue footer */
-    PUT(heap_listp + (3 * WSIZE), PACK(0, 1));     /* Epilogue header */
-    
-    heap_listp += (2 * WSIZE);
-    free_listp = nullptr;
-
-    /* Extend the empty heap with a free block of CHUNKSIZE bytes */
-    if (extend_heap(CHUNKSIZE / WSIZE) == nullptr) return -1;
-    return 0;
-}
-
-/*
- * mm_malloc - Allocate a block with at least size bytes of payload.
- *
- * TODO: Implement this function.
- *
- * Steps:
- * 1. Return nullptr for size == 0.
- * 2. Compute the adjusted size asize that includes header+footer overhead
- *    and satisfies alignment:
- *      if size <= DSIZE:  asize = 2 * DSIZE         (minimum block)
- *      else:              asize = DSIZE * ((size + DSIZE + DSIZE-1) / DSIZE)
- * 3. Search free list: bp = find_fit(asize).
- *    If found, call place(bp, asize) and return bp.
- * 4. If not found, extend heap by max(asize, CHUNKSIZE), place, return.
- *    Return nullptr if extend_heap fails.
- *
- * Return: pointer to allocated payload, or nullptr on failure.
- */
-void *mm_malloc(size_t size) {
-    size_t asize;      
-    size_t extendsize; 
-    char *bp;
-
-    if (size == 0) return nullptr;
-
-    /* Adjust block size to include overhead and alignment requirements */
-    if (size <= DSIZE) {
-        asize = 2 * DSIZE; 
-    } else {
-        asize = DSIZE * ((size + (DSIZE) + (DSIZE - 1)) / DSIZE);
-    }
-
-    /* Search the free list for a fit */
-    if ((bp = (char*)find_fit(asize)) != nullptr) {
-        place(bp, asize);
-        return bp;
-    }
-
-    /* No fit found. Get more memory and place the block */
-    extendsize = (asize > CHUNKSIZE) ? asize : CHUNKSIZE;
-    if ((bp = (char*)extend_heap(extendsize / WSIZE)) == nullptr) return nullptr;
-    
-    place(bp, asize);
-    return bp;
-}
-
-/*
- * mm_free - Free a previously allocated block.
- *
- * TODO: Implement this function. (NOT required for checkpoint.)
- *
- * Steps:
- * 1. Return immediately if ptr == nullptr.
- * 2. Read the block size from the header.
- * 3. Clear the allocated bit in both header and footer.
- * 4. Call coalesce(ptr).
- *
- * IMPORTANT: Do NOT call add_to_free_list() here.
- * coalesce() handles adding the final merged block to the free list.
- * Calling add_to_free_list() in both places would insert the block
- * twice and silently corrupt the list.
- *
- * Return: nothing.
- */
-void mm_free(void *ptr) {
-    /* TODO: Guard against nullptr */
-
-    /* TODO: Read block size */
-    /* Hint: size_t size = GET_SIZE(HDRP(ptr)); */
-
-    /* TODO: Clear allocated bit in header and footer */
-    /* Hint: PUT(HDRP(ptr), PACK(size, 0)); */
-    /* Hint: PUT(FTRP(ptr), PACK(size, 0)); */
-
-    /* TODO: Coalesce and add to free list */
-    /* Hint: coalesce(ptr); */
-}
-
-/*
- * mm_realloc - Resize a previously allocated block. (OPTIONAL -- extra credit)
- *
- * A correct naive implementation is provided. For extra credit, replace it
- * with an in-place version that avoids an unnecessary copy when the next
- * block is free and the combined size is sufficient.
- *
- * Return: pointer to resized block, or nullptr on failure.
- */
-void *mm_realloc(void *ptr, size_t size) {
-    if (ptr == nullptr)   return mm_malloc(size);
-    if (size == 0)        { mm_free(ptr); return nullptr; }
-
-    void *newptr = mm_malloc(size);
-    if (newptr == nullptr) return nullptr;
-
-    size_t copy_size = GET_SIZE(HDRP(ptr)) - DSIZE;  /* payload only: subtract header + footer */
-    if (size < copy_size) copy_size = size;
-    memcpy(newptr, ptr, copy_size);
-    mm_free(ptr);
-    return newptr;
-}
-
-/* ============================================
- * Helper Functions
- * ============================================ */
-
-/*
- * extend_heap - Extend the heap by (words * WSIZE) bytes.
- *
- * TODO: Implement this function.
- *
- * Steps:
- * 1. Round words up to an even number:
- *      size = (words % 2) ? (words+1)*WSIZE : words*WSIZE;
- * 2. Call mem_sbrk(size). Return nullptr if it fails.
- *    mem_sbrk returns the OLD break pointer. Because the header
- *    sits 4 bytes before the payload, that old break is exactly bp.
- * 3. Write new free block header:  PUT(HDRP(bp), PACK(size, 0))
- *    Write new free block footer:  PUT(FTRP(bp), PACK(size, 0))
- * 4. Write new epilogue past the block: PUT(HDRP(NEXT_BLKP(bp)), PACK(0,1))
- * 5. Return coalesce(bp) -- do NOT call add_to_free_list directly.
- *
- * Return: pointer to the new free block (possibly merged), or nullptr.
- */
-static void *extend_heap(size_t words) {
-    char *bp;
-    size_t size = (words % 2) ? (words + 1) * WSIZE : words * WSIZE;
-
-    if ((long)(bp = (char*)mem_sbrk(size)) == -1) return nullptr;
-
-    /* Initialize free block header/footer and the new epilogue header */
-    PUT(HDRP(bp), PACK(size, 0));         /* Free block header */
-    PUT(FTRP(bp), PACK(size, 0));         /* Free block footer */
-    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
-
-    /* Coalesce merges with previous if possible and adds to free list */
-    return coalesce(bp);
-}
-
-/*
- * coalesce - Merge bp with any adjacent free blocks, then add to free list.
- *
- * TODO: Implement this function. (NOT required for checkpoint.)
- *
- * Always call this immediately after marking a block free -- never call
- * add_to_free_list() directly from mm_free().
- *
- * Four cases based on neighbor allocation status:
- *   Case 1: prev alloc,  next alloc  -- no merge
- *   Case 2: prev alloc,  next free   -- merge with next
- *   Case 3: prev free,   next alloc  -- merge with prev
- *   Case 4: prev free,   next free   -- merge with both
- *
- * For every block you absorb, call remove_from_free_list() BEFORE
- * updating any sizes. Changing sizes first corrupts the list because
- * removal relies on reading correct size/pointer fields.
- *
- * In cases 3 and 4, set bp = PREV_BLKP(bp) after merging so that bp
- * refers to the start of the combined block when add_to_free_list is called.
- *
- * Hints:
- *   int prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
- *   int next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
- *   size_t size    = GET_SIZE(HDRP(bp));
- *
- * Return: pointer to the (possibly enlarged) free block.
- */
-static void *coalesce(void *bp) {
-    // 1. Get allocation status of neighbors
-    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
-    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
-    size_t size = GET_SIZE(HDRP(bp));
-
-    // 2. Handle the 4 cases
-    if (prev_alloc && next_alloc) {            /* Case 1: Both allocated */
-        // Nothing to merge
-    } 
-    else if (prev_alloc && !next_alloc) {      /* Case 2: Merge with next */
-        remove_from_free_list(NEXT_BLKP(bp));
-        size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-        PUT(HDRP(bp), PACK(size, 0));
-        PUT(FTRP(bp), PACK(size, 0));
-    } 
-    else if (!prev_alloc && next_alloc) {      /* Case 3: Merge with prev */
-        remove_from_free_list(PREV_BLKP(bp));
-        size += GET_SIZE(HDRP(PREV_BLKP(bp)));
-        PUT(FTRP(bp), PACK(size, 0));
-        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-        bp = PREV_BLKP(bp);
-    } 
-    else {                                     /* Case 4: Merge both */
-        remove_from_free_list(PREV_BLKP(bp));
-        remove_from_free_list(NEXT_BLKP(bp));
-        size += GET_SIZE(HDRP(PREV_BLKP(bp))) + GET_SIZE(FTRP(NEXT_BLKP(bp)));
-        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-        PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
-        bp = PREV_BLKP(bp);
-    }
-
-    // 3. Add the resulting block to the free list
-    add_to_free_list(bp);
-    return bp;
-}
-
-/*
- * find_fit - Return the first free block >= asize bytes, or nullptr.
- *
- * TODO: Implement this function.
- *
- * Traverse the explicit free list from free_listp using GET_NEXT_FREE.
- * Return the first block whose header reports a size >= asize.
- *
- * Hint:
- *   for (void *bp = free_listp; bp != nullptr; bp = GET_NEXT_FREE(bp))
- *       if (GET_SIZE(HDRP(bp)) >= asize) return bp;
- */
-static void *find_fit(size_t asize) {
-    /* First-fit search of the explicit free list */
-    for (void *bp = free_listp; bp != nullptr; bp = GET_NEXT_FREE(bp)) {
-        if (asize <= GET_SIZE(HDRP(bp))) {
-            return bp;
-        }
-    }
-    return nullptr;
-}
-
-/*
- * place - Allocate asize bytes at bp, splitting if the remainder is usable.
- *
- * TODO: Implement this function.
- *
- * Steps:
- * 1. Read csize = GET_SIZE(HDRP(bp)).
- * 2. remove_from_free_list(bp).
- * 3. If (csize - asize) >= MIN_BLOCK_SIZE:
- *      - Write allocated header+footer for first asize bytes.
- *      - Advance bp to NEXT_BLKP(bp).
- *      - Write free header+footer for remaining (csize-asize) bytes.
- *      - add_to_free_list(bp) for the leftover.
- *    Else:
- *      - Write allocated header+footer using full csize.
- *    Note: use MIN_BLOCK_SIZE (not 2*DSIZE) as the threshold. On 64-bit systems
- *    a remainder of only 16 bytes cannot hold the two free-list pointers.
- *
- * Return: nothing.
- */
-static void place(void *bp, size_t asize) {
-    size_t csize = GET_SIZE(HDRP(bp));
-    remove_from_free_list(bp);
-
-    if ((csize - asize) >= MIN_BLOCK_SIZE) {
-        PUT(HDRP(bp), PACK(asize, 1));
-        PUT(FTRP(bp), PACK(asize, 1));
-        bp = NEXT_BLKP(bp);
-        PUT(HDRP(bp), PACK(csize - asize, 0));
-        PUT(FTRP(bp), PACK(csize - asize, 0));
-        add_to_free_list(bp);
-    } else {
-        PUT(HDRP(bp), PACK(csize, 1));
-        PUT(FTRP(bp), PACK(csize, 1));
-    }
-}
-
-/*
- * add_to_free_list - Insert bp at the head of the free list (LIFO).
- *
- * TODO: Implement this function.
- *
- * Steps:
- * 1. SET_NEXT_FREE(bp, free_listp)      -- bp's next = old head
- * 2. SET_PREV_FREE(bp, nullptr)          -- bp has no predecessor
- * 3. If free_listp != nullptr:
- *      SET_PREV_FREE(free_listp, bp)    -- old head's prev = bp
- * 4. free_listp = (char*)bp            -- bp is new head
- *
- * Return: nothing.
- */
-static void add_to_free_list(void *bp) {
-    SET_NEXT_FREE(bp, free_listp);
-    SET_PREV_FREE(bp, nullptr);
-    if (free_listp != nullptr) {
-        SET_PREV_FREE(free_listp, bp);
-    }
-    free_listp = (char*)bp;
-}
-
-/*
- * remove_from_free_list - Unlink bp from the free list.
- *
- * TODO: Implement this function.
- *
- * Steps:
- * 1. void *prev = GET_PREV_FREE(bp);
- *    void *next = GET_NEXT_FREE(bp);
- * 2. If prev == nullptr: free_listp = (char*)next   (bp was head)
- *    Else:               SET_NEXT_FREE(prev, next)
- * 3. If next != nullptr: SET_PREV_FREE(next, prev)
- *
- * Return: nothing.
- */
-static void remove_from_free_list(void *bp) {
-    void *prev = GET_PREV_FREE(bp);
-    void *next = GET_NEXT_FREE(bp);
-
-    if (prev == nullptr) {
-        free_listp = (char*)next;
-    } else {
-        SET_NEXT_FREE(prev, next);
-    }
-
-    if (next != nullptr) {
-        SET_PREV_FREE(next, prev);
-    }
-}
-
-/*
- * mm_check - Heap consistency checker. (Optional but strongly recommended.)
- *
- * Suggested checks:
- *   1. Every block in the free list is marked free.
- *   2. No two adjacent free blocks exist (escaped coalescing).
- *   3. Every free block in the heap appears in the free list.
- *   4. Free list is doubly-linked consistently (node->next->prev == node).
- *   5. No block extends outside heap bounds.
- *   6. Header and footer of each block agree on size and alloc bit.
- *
- * Call mm_check() after every malloc/free during development.
- * Remove calls (or guard with #ifdef DEBUG) before final submission.
- *
- * Return: 0 if consistent, non-zero on any error.
- */
-int mm_check(void) {
-    /* TODO: Optional -- implement consistency checks here */
-    return 0;
-}
+/*
+ * Memory Allocator Implementation (C++)
+ *
+ * This file implements malloc and free using an explicit free list.
+ *
+ * BLOCK STRUCTURE:
+ * - Every block has a header containing size, allocated bit, and a
+ *   prev-allocated bit recording whether the block before it is in use
+ * - Only free blocks carry a footer; allocated blocks give that word to
+ *   the payload. coalesce() reads the previous block's footer only
+ *   when the prev-allocated bit says that block is free.
+ * - Free blocks store next and prev pointers in the payload area
+ * - Minimum block size on 64-bit systems is 24 bytes:
+ *     header(4) + next ptr(8) + prev ptr(8) + footer(4) = 24 bytes
+ *   rounded up to ALIGNMENT (32 at 16-byte alignment). With 8-byte
+ *   header words it is 32 bytes at either alignment:
+ *     header(8) + next ptr(8) + prev ptr(8) + footer(8) = 32 bytes
+ *   The split threshold in place() accounts for this (see
+ *   MIN_BLOCK_SIZE below)
+ * - All payloads are ALIGNMENT-aligned: MM_ALIGNMENT (allocator.h), 16
+ *   bytes by default on x86-64, else 8. Block sizes are multiples of it
+ *   and every region puts its first payload on such a boundary
+ * - Header and footer words are 4 bytes, or 8 with -DMM_WIDE_HEADERS=1
+ *   (`make wide`). A region never grows past MAX_REGION_SIZE, which a
+ *   header word can always hold, so no block -- split, grown or merged --
+ *   outgrows its header. Requests too big for a region are mapped.
+ *
+ * FREE LIST STRUCTURE:
+ * - Segregated explicit free lists indexed TLSF-style by two levels:
+ *   first level = power of two, second level = SL_COUNT linear slices
+ * - Each list is doubly-linked, LIFO (insert freed blocks at the head)
+ * - nullptr-terminated (no sentinel node)
+ * - free_lists[fl][sl] points to the head of a bin, or nullptr if empty
+ * - fl_bitmap / sl_bitmap[] mark the non-empty bins so find_fit can
+ *   locate the first usable bin with count-trailing-zeros, no scanning
+ * - Bins of BEST_FIT_MIN bytes and up are not lists but treaps keyed by
+ *   (size, address), so a large request gets the smallest block that
+ *   fits, lowest address first, in O(log n): a lower-bound search in its
+ *   own bin, else the smallest block of the next non-empty bin.
+ *   Small bins stay LIFO lists (MM_FIT_POLICY=best, the default).
+ * - MM_FIT_POLICY=lifo at mm_init makes every bin a list
+ * - With MM_FIT_POLICY=address, every free block big enough to hold a
+ *   tree node goes in the tree, keyed by address alone. Each node also
+ *   records the largest block in its subtree, so find_fit takes the
+ *   lowest-addressed block that fits in O(log n). Only blocks too small
+ *   for a node stay in the bins.
+ *
+ * SLAB LAYER:
+ * - Requests of at most SLAB_MAX_SIZE bytes never touch the block heap.
+ *   They are served from runs: CHUNKSIZE pages cut into equal slots of
+ *   one size class, with no header, footer or minimum block size
+ * - A SlabRun descriptor at the start of each run page holds its class
+ *   and a bitmap of free slots; malloc takes the lowest set bit with ctz
+ * - The page map tags run pages, so mm_free and mm_realloc tell slab
+ *   slots from heap blocks by address alone, before reading any header
+ *
+ * LARGE ALLOCATIONS:
+ * - Requests of mmap_threshold bytes or more (MM_MMAP_THRESHOLD at
+ *   mm_init, default MMAP_THRESHOLD_DEFAULT, 0 = never) bypass the heap
+ *   and get a mapping of their own from mem_map; so do requests too big
+ *   for any heap region, whatever the threshold
+ * - The mapping's length is kept in front of the payload; a pointer
+ *   outside memlib's heap range is recognized as mapped by address
+ * - mm_free unmaps it at once; mm_realloc resizes it with mem_remap,
+ *   which moves pages rather than copying bytes
+ *
+ * RETURNING MEMORY:
+ * - When a free of at least the arena's trim threshold ends at the
+ *   memlib break, the heap is trimmed: all but one page of it goes back
+ *   to memlib through a negative mem_sbrk. An arena that has to grow
+ *   again after a trim doubles its threshold, so a heap that swings
+ *   between bursts stops handing back pages it is about to ask for.
+ * - Each arena counts the bytes freed into it. Every PURGE_THRESHOLD
+ *   bytes, the page-aligned interior of each large free block that has
+ *   not changed since the previous time is purged with mem_purge. The
+ *   block keeps its address range but drops its physical pages until
+ *   something is placed there again.
+ * - The purge state lives in the free block's footer (PURGE_BITS), so
+ *   a purged block is passed over until it changes. Splits and trims
+ *   keep the state; a merge or any other rewrite resets it, and the
+ *   block waits out another round before it is purged again.
+ *
+ * DEFERRED COALESCING (build with -DMM_DEFER_COALESCE=1, or `make defer`):
+ * - mm_free parks heap blocks of up to QUICK_MAX_SIZE bytes on per-size
+ *   quick lists instead of coalescing them; they stay marked allocated so
+ *   neighbors leave them be
+ * - mm_malloc reuses a parked block of the exact size without splitting
+ * - When find_fit misses, every parked block is freed and coalesced in
+ *   one batch before the heap is extended
+ *
+ * THREADING:
+ * - The heap is split into arenas. Each arena has its own free lists,
+ *   bitmaps, quick lists and lock, and grows by carving regions out of
+ *   memlib. mem_sbrk itself is serialized by sbrk_lock.
+ * - Threads are bound to arenas round-robin the first time they allocate
+ * - A page map records which arena owns each heap page. A block freed by
+ *   a thread bound to a different arena is pushed onto the owner's
+ *   lock-free remote-free stack instead of taking the owner's lock; the
+ *   owner drains the whole stack in one exchange on its next slow-path
+ *   malloc, before searching its free lists
+ * - Each thread keeps a tcache: per-size LIFO stacks of recently freed
+ *   slab slots and small blocks, at most TCACHE_BIN_MAX each. Cached
+ *   entries stay marked allocated in their run or heap, exactly like
+ *   quick-list blocks.
+ * - A malloc/free pair that hits the tcache never takes a lock; a miss
+ *   refills TCACHE_FILL blocks from the thread's arena and a full bin
+ *   spills half of its blocks to their owners, each in one batch
+ * - mm_init bumps heap_generation so caches filled against an earlier
+ *   heap are discarded instead of handing out dangling blocks
+ *
+ * STATISTICS (mm_get_stats):
+ * - Every thread counts its mallocs and frees per size class in its own
+ *   ThreadCache with relaxed stores, so counting costs no lock and no
+ *   shared cache line. mm_get_stats sums the counters of all live
+ *   threads plus the totals folded in by threads that have exited.
+ * - Heap-shape figures (free bytes, free blocks, largest free block) are
+ *   not tracked at all; mm_get_stats walks each arena's bins to get them
+ *
+ * ZEROED ALLOCATION (mm_calloc):
+ * - Pages fresh from mem_sbrk are zero. Memory above heap_fresh has never
+ *   been written since the heap was mapped, and extend_heap marks a new
+ *   free block that lies entirely above it with header bit 2 (ZERO_BIT).
+ * - The bit survives splits, trims and merges of zero blocks with each
+ *   other (the words that separated them are cleared). Any other header
+ *   write drops it. mm_calloc then clears only what the allocator itself
+ *   wrote into such a block: its free-list links or tree node and footer.
+ * - Mapped blocks are fresh anonymous pages and need no clearing at all.
+ *   Other blocks are cleared in full, with non-temporal stores once they
+ *   are big enough to flush the cache anyway.
+ *
+ * HARDENED MODE (build with -DMM_HARDEN=1, or `make harden`):
+ * - An allocated heap block keeps its last word, where a free block has
+ *   its footer, for a seal: a checksum of its address and size keyed by
+ *   a random harden_key. It sits right before the next block's header,
+ *   so a payload overflow clobbers the seal before the header.
+ * - mm_free and mm_realloc reject, with a message and abort(), any
+ *   pointer that is not an allocated block: outside the heap and not a
+ *   sealed mapping, not on a block or slot boundary, not marked
+ *   allocated, or with a broken seal. Blocks parked in a tcache, quick
+ *   list or remote-free stack carry harden_key in their second word, so
+ *   freeing one again is caught as a double free.
+ * - Free-list unlinking checks that the neighbors link back to the
+ *   block (safe unlinking), and every singly-linked pop checks that the
+ *   link it follows stays inside the heap.
+ *
+ * PROFILING (build with -DMM_PROFILE=1, or `make profile`):
+ * - Each arena keeps a histogram of how many free blocks find_fit
+ *   visits per call, updated under the arena lock it already holds
+ * - Each thread keeps cycle-counter histograms of its mm_malloc and
+ *   mm_free latencies, next to its statistics counters
+ * - mm_get_profile merges them and reports p50/p99/p999. Without
+ *   MM_PROFILE the hooks and the histograms compile away entirely.
+ *
+ * C++ USAGE NOTES:
+ * - Use modern C++ features where helpful (nullptr, references, constexpr)
+ * - DO NOT use new/delete (infinite recursion -- they call malloc!)
+ * - DO NOT use STL containers (they call malloc internally!)
+ * - DO NOT use smart pointers
+ * - std::mutex, std::atomic and thread_local are fine: none of them
+ *   allocate through this allocator
+ * - Pointer arithmetic and casts are necessary for this low-level code
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+#include <ctime>
+#include <atomic>
+#include <mutex>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "allocator.h"
+#include "memlib.h"
+
+/* ============================================
+ * Constants
+ *
+ * Integer constants can and should be constexpr in C++ -- it gives
+ * type safety and lets the compiler catch mistakes that #define cannot.
+ *
+ * The pointer-manipulating macros below (HDRP, FTRP, GET, PUT, etc.)
+ * cannot be constexpr because they dereference runtime addresses.
+ * That is why those remain as #define macros rather than constexpr.
+ * ============================================ */
+
+/*
+ * Header and footer word, chosen at build time with -DMM_WIDE_HEADERS
+ * (see allocator.h): 32 bits by default, 64 bits for heap blocks of
+ * 4 GB and more.
+ */
+#if MM_WIDE_HEADERS
+typedef uint64_t word_t;
+#else
+typedef uint32_t word_t;
+#endif
+
+constexpr size_t WSIZE     = sizeof(word_t);  /* Word size in bytes              */
+constexpr size_t DSIZE     = 2 * WSIZE;       /* Double word size in bytes       */
+constexpr size_t CHUNKSIZE = (1 << 12);       /* Default heap extension size 4KB */
+
+/*
+ * Payload alignment, chosen at build time with -DMM_ALIGNMENT=8 or 16
+ * (see allocator.h). Every block size is a multiple of ALIGNMENT, so
+ * payloads keep the alignment of the first one in their region.
+ */
+constexpr size_t ALIGNMENT = MM_ALIGNMENT;
+static_assert(ALIGNMENT == 8 || ALIGNMENT == 16, "MM_ALIGNMENT must be 8 or 16");
+
+/*
+ * Minimum free block size.
+ * A free block must hold: header(4) + next ptr + prev ptr + footer(4).
+ * On a 64-bit system sizeof(void*) == 8, so the minimum is 4+8+8+4 = 24 bytes.
+ * We round up to the next multiple of ALIGNMENT → 24, or 32 at 16-byte
+ * alignment (32 either way with 8-byte header words). Use this as the
+ * split threshold in place() rather than 2*DSIZE, which would be too
+ * small to store the two free-list pointers.
+ */
+constexpr size_t MIN_BLOCK_SIZE = ALIGNMENT * ((DSIZE + 2 * sizeof(void *) + ALIGNMENT - 1) / ALIGNMENT);
+
+/*
+ * Hardened mode (see HARDENED MODE above).
+ * ALLOC_OVERHEAD is what an allocated heap block keeps from its payload:
+ * the header, plus the seal word in hardened mode.
+ */
+#ifndef MM_HARDEN
+#define MM_HARDEN 0
+#endif
+constexpr bool   HARDEN           = MM_HARDEN;
+constexpr size_t ALLOC_OVERHEAD   = HARDEN ? 2 * WSIZE : WSIZE;
+
+/*
+ * Two-level segregated fit (TLSF) bin layout.
+ *
+ * Sizes below SMALL_BLOCK_SIZE go in first-level bin 0, split linearly
+ * into 8-byte slices (2^SMALL_SLICE_LOG2), the finest step between block
+ * sizes whatever ALIGNMENT and the header width are. A larger size with
+ * most significant bit m goes in first-level bin m - FL_SHIFT + 1, whose
+ * range [2^m, 2^(m+1)) is cut into SL_COUNT equal slices. No block
+ * reaches 2^FL_MAX_LOG2 bytes (see MAX_REGION_SIZE): 4 GB with 32-bit
+ * header words, 256 TB with 64-bit ones. Either way FL_COUNT stays under
+ * the 64 bits of fl_bitmap.
+ *
+ * FIT_PROBE_LIMIT bounds the first-fit walk of the request's own bin
+ * (which mixes sizes just below and just above asize) before find_fit
+ * jumps to the next bin up, where every block is guaranteed to fit.
+ */
+constexpr int    SL_LOG2          = 4;
+constexpr int    SL_COUNT         = 1 << SL_LOG2;                 /* 16  */
+constexpr int    SMALL_SLICE_LOG2 = 3;                            /* 8-byte slices */
+constexpr int    FL_SHIFT         = SL_LOG2 + SMALL_SLICE_LOG2;
+constexpr size_t SMALL_BLOCK_SIZE = size_t(1) << FL_SHIFT;        /* 128 */
+constexpr int    FL_MAX_LOG2      = MM_WIDE_HEADERS ? 48 : 32;
+constexpr int    FL_COUNT         = FL_MAX_LOG2 - FL_SHIFT + 1;   /* 26, or 42 */
+constexpr int    FIT_PROBE_LIMIT  = 8;
+
+/*
+ * Free-block tree (see fit_policy).
+ * A tree node sits at the start of a free block's payload: left and
+ * right child pointers, then the largest block size in the subtree.
+ * TREE_MIN_BLOCK is the smallest block that fits a node besides its
+ * header and footer; the address-ordered policy puts every block that
+ * size or larger in the arena's tree. The best-fit policy turns every
+ * bin from first level BEST_FIT_FL up (blocks of BEST_FIT_MIN bytes or
+ * more, where a better fit saves the most space) into a tree of its own.
+ */
+constexpr size_t TREE_NODE_SIZE   = 2 * sizeof(void *) + WSIZE;
+constexpr size_t TREE_MIN_BLOCK   = DSIZE * ((TREE_NODE_SIZE + 2 * WSIZE + DSIZE - 1) / DSIZE);
+constexpr int    BEST_FIT_LOG2    = 12;
+constexpr size_t BEST_FIT_MIN     = size_t(1) << BEST_FIT_LOG2;           /* 4 KB */
+constexpr int    BEST_FIT_FL      = BEST_FIT_LOG2 - FL_SHIFT + 1;
+
+static_assert(BEST_FIT_LOG2 >= FL_SHIFT, "BEST_FIT_MIN must start a first-level bin");
+
+static_assert(ALIGNMENT % (size_t(1) << SMALL_SLICE_LOG2) == 0,
+              "every block size starts a bin-0 slice");
+static_assert(FL_COUNT <= 64, "fl_bitmap is a single 64-bit word");
+static_assert(SL_COUNT <= 32, "sl_bitmap entries are 32-bit words");
+
+/*
+ * Slab size classes.
+ * Classes step by 16 bytes up to 128 and by 32 bytes up to SLAB_MAX_SIZE
+ * (see slab_class). A run is one CHUNKSIZE page: a SlabRun descriptor,
+ * padded to SLAB_ALIGN, followed by the slots. Every class is a multiple
+ * of SLAB_ALIGN, so every slot is aligned at least as well as a block.
+ */
+constexpr size_t   SLAB_MAX_SIZE    = 256;
+constexpr int      SLAB_COUNT       = 12;
+constexpr size_t   SLAB_ALIGN       = 16;
+constexpr uint16_t SLAB_SIZES[SLAB_COUNT] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256
+};
+constexpr int      SLAB_MAP_WORDS   = 4;          /* Up to 256 slots per run */
+static_assert(SLAB_ALIGN % ALIGNMENT == 0, "slab slots are aligned");
+
+/*
+ * Per-thread cache (tcache) geometry.
+ * The first SLAB_COUNT bins hold slab slots, one per class. After them
+ * comes one bin per heap block size from TCACHE_MIN_SIZE (the smallest
+ * block mm_malloc hands out above the slab classes) up to
+ * TCACHE_MAX_SIZE in ALIGNMENT steps. A bin holds at most TCACHE_BIN_MAX
+ * blocks; a miss pulls TCACHE_FILL blocks from the thread's arena at once.
+ */
+constexpr size_t TCACHE_MIN_SIZE  = ALIGNMENT * ((SLAB_MAX_SIZE + 1 + ALLOC_OVERHEAD + ALIGNMENT - 1) / ALIGNMENT);
+constexpr size_t TCACHE_MAX_SIZE  = 512;
+constexpr int    TCACHE_COUNT     = SLAB_COUNT + (TCACHE_MAX_SIZE - TCACHE_MIN_SIZE) / ALIGNMENT + 1;
+constexpr int    TCACHE_BIN_MAX   = 16;
+constexpr int    TCACHE_FILL      = 4;
+
+/*
+ * Deferred coalescing quick lists.
+ * One singly-linked list per block size from QUICK_MIN_SIZE up to
+ * QUICK_MAX_SIZE in ALIGNMENT steps, each holding at most QUICK_LIST_MAX
+ * parked blocks. Smaller requests never reach the arena's block heap
+ * (they are slab slots), so the lists start at the smallest heap block
+ * mm_malloc hands out and run past the tcache range: they take tcache
+ * spills and serve tcache refills as well as direct requests up to
+ * 1 KB. Other frees, and frees beyond a list's cap, coalesce immediately.
+ */
+#ifndef MM_DEFER_COALESCE
+#define MM_DEFER_COALESCE 0
+#endif
+constexpr bool   DEFER_COALESCE   = MM_DEFER_COALESCE;
+constexpr size_t QUICK_MIN_SIZE   = TCACHE_MIN_SIZE;
+constexpr size_t QUICK_MAX_SIZE   = 1024;
+constexpr int    QUICK_COUNT      = (QUICK_MAX_SIZE - QUICK_MIN_SIZE) / ALIGNMENT + 1;
+constexpr int    QUICK_LIST_MAX   = 32;
+
+static_assert(QUICK_MAX_SIZE > TCACHE_MAX_SIZE, "quick lists reach past the tcache range");
+
+/*
+ * Large allocations.
+ * A mapped block is MMAP_OVERHEAD bytes of bookkeeping (the mapping
+ * length, padded to keep the payload aligned) followed by the payload,
+ * rounded up to whole pages.
+ */
+constexpr size_t MMAP_THRESHOLD_DEFAULT = 128 * 1024;
+constexpr size_t MMAP_OVERHEAD          = 2 * sizeof(uint64_t);
+static_assert(MMAP_OVERHEAD % ALIGNMENT == 0, "mapped payloads are aligned");
+
+/*
+ * mm_calloc clears blocks of at least CALLOC_STREAM_MIN bytes with
+ * non-temporal stores. That is more than most last-level caches hold, so
+ * caching the zeros would evict everything else; below it, memset into
+ * the cache is faster (about 3x at 1 MB).
+ */
+constexpr size_t CALLOC_STREAM_MIN      = 32 * 1024 * 1024;
+
+/*
+ * Returning memory to the OS.
+ * A free block of at least an arena's trim threshold at the memlib break
+ * is cut back to one CHUNKSIZE page. The threshold starts at
+ * TRIM_THRESHOLD and doubles, up to TRIM_THRESHOLD_MAX, each time the
+ * arena has to grow again after a trim. Every PURGE_THRESHOLD bytes freed
+ * into an arena, free blocks of at least PURGE_MIN_BLOCK bytes, which
+ * always contain a whole interior page, have their pages purged once
+ * they have gone a whole round unchanged (see arena_purge).
+ */
+constexpr size_t TRIM_THRESHOLD     = 128 * 1024;
+constexpr size_t TRIM_THRESHOLD_MAX = 64 * 1024 * 1024;
+constexpr size_t PURGE_THRESHOLD    = 1024 * 1024;
+constexpr size_t PURGE_MIN_BLOCK    = 4 * CHUNKSIZE;
+
+/*
+ * Statistics size classes (see struct mm_stats).
+ * The first SLAB_COUNT classes are the slab classes; class SLAB_COUNT + k
+ * covers usable sizes up to 2^(STATS_LOG2_BASE + k); the last class takes
+ * everything larger.
+ */
+constexpr int    STATS_LOG2_BASE  = 9;
+
+static_assert(size_t(1) << STATS_LOG2_BASE == 2 * SLAB_MAX_SIZE,
+              "first power-of-two class starts right after the slab classes");
+static_assert(SLAB_COUNT < MM_STATS_CLASSES, "slab classes fit the stats classes");
+
+/*
+ * Profiling (see struct mm_profile).
+ * Latencies below LAT_SUB_COUNT ticks get a bucket each; above that,
+ * every power of two is cut into LAT_SUB_COUNT equal buckets, which
+ * covers the whole 64-bit range in LAT_BUCKETS buckets.
+ */
+#ifndef MM_PROFILE
+#define MM_PROFILE 0
+#endif
+constexpr int    LAT_SUB_LOG2     = 2;
+constexpr int    LAT_SUB_COUNT    = 1 << LAT_SUB_LOG2;
+constexpr int    LAT_BUCKETS      = (64 - LAT_SUB_LOG2 + 1) * LAT_SUB_COUNT;
+constexpr int    LAT_MALLOC       = 0;
+constexpr int    LAT_FREE         = 1;
+constexpr int    LAT_KINDS        = 2;
+
+/*
+ * Incremental heap checking (see mm_check_incremental).
+ * Each arena remembers the last TOUCH_COUNT blocks and slab slots its
+ * operations allocated, freed or reshaped.
+ */
+constexpr unsigned TOUCH_COUNT    = 16;
+
+static_assert((TOUCH_COUNT & (TOUCH_COUNT - 1)) == 0, "touched ring indexes with a mask");
+
+/*
+ * Arenas.
+ * Up to MAX_ARENAS independent heaps, each with its own lock. The number
+ * in use is read from the MM_ARENAS environment variable at mm_init, or
+ * defaults to twice the number of online CPUs. Arenas grow by carving
+ * regions out of memlib with mem_sbrk, always in whole CHUNKSIZE pages;
+ * each region is framed by its own prologue and epilogue. Slab runs are
+ * separate single pages, tagged PAGE_SLAB in the page map.
+ *
+ * A region never grows past MAX_REGION_SIZE, and no block spans two
+ * regions, so every block size fits a header word and a TLSF bin.
+ * HEAP_REQUEST_MAX is the largest request a region can hold; bigger
+ * ones are mapped whatever mmap_threshold says.
+ */
+constexpr int     MAX_ARENAS       = 16;
+constexpr int     PAGE_SHIFT       = 12;
+constexpr size_t  REGION_OVERHEAD  = 4 * WSIZE;   /* pad + prologue + epilogue */
+constexpr uint8_t PAGE_SLAB        = 0x80;        /* Page map: page is a slab run */
+constexpr uint8_t PAGE_ARENA_MASK  = 0x7f;        /* Page map: 1 + owning arena   */
+constexpr size_t  MAX_REGION_SIZE  = (size_t(1) << FL_MAX_LOG2) - CHUNKSIZE;
+constexpr size_t  HEAP_REQUEST_MAX = MAX_REGION_SIZE - REGION_OVERHEAD - ALLOC_OVERHEAD - ALIGNMENT;
+
+static_assert((size_t(1) << PAGE_SHIFT) == CHUNKSIZE, "page map granule is CHUNKSIZE");
+static_assert(REGION_OVERHEAD % ALIGNMENT == 0, "a region's first payload is aligned");
+static_assert(MAX_REGION_SIZE <= word_t(~word_t(0x7)), "a header word holds any block size");
+static_assert(MAX_ARENAS < PAGE_ARENA_MASK, "arena index must fit below PAGE_SLAB");
+
+/* ============================================
+ * Macros
+ * ============================================ */
+
+/*
+ * Pack a size, prev-allocated bit and allocated bit into a single word.
+ * Header bit 0 = this block allocated, bit 1 = previous block allocated.
+ * Footers (free blocks only) store the size and the purge state (see
+ * PURGE_BITS); their bit 1 is unused.
+ */
+#define PACK(size, prev_alloc, alloc)  ((size) | ((prev_alloc) << 1) | (alloc))
+
+/* Read and write a header word at address p */
+#define GET(p)       (*(word_t *)(p))
+#define PUT(p, val)  (*(word_t *)(p) = (val))
+
+/* Extract size, allocated bit and prev-allocated bit from a word at address p */
+#define GET_SIZE(p)        (GET(p) & ~0x7)
+#define GET_ALLOC(p)       (GET(p) & 0x1)
+#define GET_PREV_ALLOC(p)  ((GET(p) & 0x2) >> 1)
+
+/*
+ * Bit 2 of a free block's header: apart from its first TREE_NODE_SIZE
+ * bytes (free-list links or tree node) and its footer, the block is
+ * known to be zero. PACK never sets it, so rewriting a header drops it
+ * unless the caller carries it over explicitly.
+ */
+#define ZERO_BIT     0x4
+#define GET_ZERO(p)  (GET(p) & ZERO_BIT)
+
+/*
+ * Purge state, in bits 0 and 2 of a free block's footer (see
+ * arena_purge). IDLE_BIT: the block has been through a purge pass
+ * unchanged. PURGED_BIT: the whole pages strictly between its first
+ * TREE_NODE_SIZE bytes and its footer have been purged and not written
+ * since. Like ZERO_BIT, both are dropped by any footer write that does
+ * not carry them over.
+ */
+#define PURGED_BIT          0x1
+#define IDLE_BIT            0x4
+#define PURGE_BITS          (PURGED_BIT | IDLE_BIT)
+#define GET_PURGE_BITS(p)   (GET(p) & PURGE_BITS)
+
+/*
+ * Set or clear the prev-allocated bit of the header at address p.
+ * This is the one header write that can land on a block another thread
+ * owns, which reads its own size lock-free through GET_SIZE_RELAXED, so
+ * both sides use relaxed atomic accesses (plain moves on x86-64).
+ */
+#define PUT_RELAXED(p, val)   __atomic_store_n((word_t *)(p), (val), __ATOMIC_RELAXED)
+#define GET_SIZE_RELAXED(p)   (__atomic_load_n((word_t *)(p), __ATOMIC_RELAXED) & ~0x7)
+#define SET_PREV_ALLOC(p)  PUT_RELAXED(p, GET(p) | 0x2)
+#define CLR_PREV_ALLOC(p)  PUT_RELAXED(p, GET(p) & ~0x2)
+
+/*
+ * Bump a per-thread statistics counter. Only the owning thread writes
+ * it, but mm_get_stats reads it from other threads, so the store is a
+ * relaxed atomic (a plain increment on x86-64).
+ */
+#define STAT_INC(c)  __atomic_store_n(&(c), (c) + 1, __ATOMIC_RELAXED)
+
+/*
+ * Profiling hooks. PROFILE_FIT records a find_fit call that visited
+ * nodes free blocks (caller holds ar->lock). PROFILE_LATENCY times the
+ * rest of the enclosing scope into the calling thread's histogram of
+ * the given kind. Without MM_PROFILE both expand to nothing.
+ */
+#if MM_PROFILE
+#define PROFILE_FIT(ar, nodes)  (++(ar)->fit_hist[(nodes) < MM_FIT_BUCKETS ? (nodes) : MM_FIT_BUCKETS - 1])
+#define PROFILE_LATENCY(kind)   LatencyTimer latency_timer_(kind)
+#else
+#define PROFILE_FIT(ar, nodes)  ((void)0)
+#define PROFILE_LATENCY(kind)   ((void)0)
+#endif
+
+/*
+ * Record that an operation on arena ar (whose lock the caller holds)
+ * left block or slab slot bp changed, for mm_check_incremental.
+ */
+#define TOUCH(ar, bp)  ((ar)->touched[(ar)->touch_next++ & (TOUCH_COUNT - 1)] = (char *)(bp))
+
+/* Length of the mapping that holds the mapped block bp, and in hardened
+ * mode its seal, in the padding after the length */
+#define MMAP_LEN(bp)   (*(size_t *)((char *)(bp) - MMAP_OVERHEAD))
+#define MMAP_SEAL(bp)  (*(uint64_t *)((char *)(bp) - sizeof(uint64_t)))
+
+/* Given a block payload pointer bp, compute address of its header and footer.
+ * FTRP is only meaningful for free blocks, and for the seal of allocated
+ * blocks in hardened mode. */
+#define HDRP(bp)  ((char *)(bp) - WSIZE)
+#define FTRP(bp)  ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
+
+/* Given a block payload pointer bp, compute payload pointer of adjacent blocks.
+ * PREV_BLKP reads the previous block's footer, so it is only valid when
+ * GET_PREV_ALLOC(HDRP(bp)) is 0. */
+#define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(HDRP(bp)))
+#define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE((char *)(bp) - DSIZE))
+
+/*
+ * Hardened mode: write the seal of the allocated block bp into its last
+ * word, once its header holds the final size. Nothing otherwise.
+ */
+#define SEAL(bp)  (HARDEN ? (void)PUT(FTRP(bp), block_seal(bp, GET_SIZE(HDRP(bp)))) : (void)0)
+
+/* ============================================
+ * Free list pointer macros
+ *
+ * Free blocks store a next and prev pointer inside their payload:
+ *
+ *   [Header WSIZE][Next sizeof(void*)][Prev sizeof(void*)][...][Footer WSIZE]
+ *              ^bp                  ^bp + sizeof(void*)
+ *
+ * GET_NEXT_FREE / GET_PREV_FREE dereference those memory locations,
+ * which produces an lvalue (a location you can assign to). That is
+ * why SET_NEXT_FREE / SET_PREV_FREE can write through those same
+ * expressions: assigning to a dereferenced pointer writes to the
+ * underlying memory. This is standard C++ -- not a trick.
+ *
+ * We use sizeof(void*) rather than DSIZE for the prev offset so the
+ * code is correct on both 32-bit (sizeof(void*)==4) and 64-bit
+ * (sizeof(void*)==8) platforms. On a 64-bit machine these happen to
+ * be equal, but being explicit avoids a silent bug on 32-bit.
+ * ============================================ */
+#define GET_NEXT_FREE(bp)       (*(void **)(bp))
+#define GET_PREV_FREE(bp)       (*(void **)((char *)(bp) + sizeof(void *)))
+#define SET_NEXT_FREE(bp, val)  (*(void **)(bp) = (val))
+#define SET_PREV_FREE(bp, val)  (*(void **)((char *)(bp) + sizeof(void *)) = (val))
+
+/*
+ * Free-tree node fields, in the same payload words as the list links
+ * (a block is only ever on one of the two). TREE_MAX is the largest
+ * block size anywhere in the subtree rooted at bp.
+ */
+#define TREE_LEFT(bp)   (*(char **)(bp))
+#define TREE_RIGHT(bp)  (*(char **)((char *)(bp) + sizeof(void *)))
+#define TREE_MAX(bp)    (*(word_t *)((char *)(bp) + 2 * sizeof(void *)))
+
+/* ============================================
+ * Global Variables
+ * ============================================ */
+
+/*
+ * Descriptor at the start of every slab run page. Bit i of free_map is
+ * set iff slot i is free. Guarded by the owning arena's lock, except cls,
+ * which only changes while every slot is free and so may be read by any
+ * thread holding a pointer into the run.
+ */
+struct SlabRun {
+    SlabRun *next;            /* Links in the owner's slab_partial[cls] list */
+    SlabRun *prev;
+    uint64_t free_map[SLAB_MAP_WORDS];
+    uint16_t cls;
+    uint16_t nslots;
+    uint16_t nfree;
+};
+
+/* Offset of slot 0 within a run page */
+constexpr size_t SLAB_HDR_SIZE = (sizeof(SlabRun) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+
+static_assert((CHUNKSIZE - SLAB_HDR_SIZE) / SLAB_SIZES[0] <= 64 * SLAB_MAP_WORDS,
+              "free_map must cover every slot of the smallest class");
+static_assert(SLAB_SIZES[SLAB_COUNT - 1] == SLAB_MAX_SIZE, "last class is SLAB_MAX_SIZE");
+
+/*
+ * One independent heap. Everything in it is guarded by its lock.
+ */
+struct Arena {
+    std::mutex lock;
+
+    /* Points to the payload of the prologue block of the arena's first
+     * region (fixed anchor for heap walks), or nullptr before that exists */
+    char *heap_listp;
+
+    /* Start and one past the epilogue of the arena's newest region; if
+     * region_end is still the memlib break, the region can grow in place,
+     * up to MAX_REGION_SIZE */
+    char *region_start;
+    char *region_end;
+
+    /* Heads of the segregated free lists, one per TLSF bin (nullptr if
+     * empty); tree roots instead for bins that are trees (see bin_is_tree) */
+    char *free_lists[FL_COUNT][SL_COUNT];
+
+    /* Bit fl set iff sl_bitmap[fl] != 0; bit sl of sl_bitmap[fl] set iff
+     * free_lists[fl][sl] is non-empty */
+    uint64_t fl_bitmap;
+    uint32_t sl_bitmap[FL_COUNT];
+
+    /* Root of the address-ordered treap (FIT_ADDRESS only) */
+    char *addr_tree;
+
+    /* Deferred-coalescing quick lists (unused unless DEFER_COALESCE) */
+    char *quick_lists[QUICK_COUNT];
+    int   quick_counts[QUICK_COUNT];
+
+    /* Slab runs of each class with at least one free and one used slot
+     * (doubly linked), and wholly free runs any class may take over
+     * (singly linked through next) */
+    SlabRun *slab_partial[SLAB_COUNT];
+    SlabRun *slab_empty;
+
+    /* Bytes freed into the heap since the last arena_purge */
+    size_t dirty_bytes;
+
+    /* Smallest free tail that free_locked trims, and whether the arena
+     * has trimmed since it last grew (see arena_trim) */
+    size_t trim_threshold;
+    bool   trimmed;
+
+    /* Ring of recently touched blocks and slots (see TOUCH); nullptr
+     * entries are unused or were merged away */
+    char    *touched[TOUCH_COUNT];
+    unsigned touch_next;
+
+    /* Blocks freed by threads bound to other arenas, still marked
+     * allocated and linked through GET_NEXT_FREE. Pushed lock-free by
+     * any thread; popped all at once by whoever holds lock. */
+    std::atomic<char *> remote_frees;
+
+#if MM_PROFILE
+    /* fit_hist[i] = find_fit calls that visited i free blocks */
+    unsigned long fit_hist[MM_FIT_BUCKETS];
+#endif
+};
+
+static Arena arenas[MAX_ARENAS];
+static int   narenas = 1;
+
+/* Round-robin counter that binds each new thread to an arena */
+static std::atomic<unsigned> next_arena{0};
+
+/* Guards calls to mem_sbrk and writes to page_owner */
+static std::mutex sbrk_lock;
+
+/*
+ * Page map: the low bits of page_owner[i] are 1 + the index of the arena
+ * that owns the i-th CHUNKSIZE page past heap_base, or 0 if the page is
+ * not yet part of the heap; PAGE_SLAB is set if the page is a slab run.
+ * Every region and run starts and ends on a page boundary, so one byte
+ * per page is enough to route any pointer back to its owner.
+ */
+static char    *heap_base      = nullptr;
+static uint8_t *page_owner     = nullptr;
+static size_t   page_owner_len = 0;
+
+/* Requests of at least this many bytes get their own mapping */
+static size_t mmap_threshold = MMAP_THRESHOLD_DEFAULT;
+
+/* Fit policy, from MM_FIT_POLICY at mm_init */
+enum FitPolicy {
+    FIT_BEST,       /* Bins from BEST_FIT_FL up are (size, address) trees */
+    FIT_LIFO,       /* Every bin is a LIFO list                           */
+    FIT_ADDRESS     /* Blocks of TREE_MIN_BLOCK and up in addr_tree       */
+};
+static FitPolicy fit_policy = FIT_BEST;
+
+/* Whether bins of first level fl are (size, address) trees, not lists */
+static inline bool bin_is_tree(int fl) {
+    return fit_policy == FIT_BEST && fl >= BEST_FIT_FL;
+}
+
+/*
+ * Hardened mode: random key for seals, drawn by mm_init. Its low bit is
+ * set, so it never equals a block pointer and can mark parked blocks.
+ */
+static uint64_t harden_key = 1;
+
+/* Incremented by every mm_init; tcaches from older heaps are stale */
+static std::atomic<unsigned> heap_generation{0};
+
+/*
+ * Heap memory at or above heap_fresh has not been written since memlib
+ * mapped it, so it is still zero. Guarded by sbrk_lock. It never moves
+ * down when the heap is trimmed: memlib may keep the trimmed bytes.
+ */
+static char *heap_fresh = nullptr;
+
+/* Number of extend_heap calls since mm_init, guarded by sbrk_lock */
+static unsigned long extend_heap_calls = 0;
+
+/* Bytes in live mapped blocks */
+static std::atomic<size_t> mapped_bytes{0};
+
+/*
+ * A thread's cache of freed slab slots and small blocks, linked through
+ * GET_NEXT_FREE, plus the arena the thread allocates from. Blocks from
+ * any arena may sit in a bin; they are routed to their owner when spilled.
+ * Zero-initialized, so a new thread's cache starts out stale (generation
+ * 0) and is reset on first use.
+ *
+ * The cache also carries the thread's statistics counters. Every cache
+ * that has been used is on stats_threads so mm_get_stats can find it.
+ */
+struct ThreadCache {
+    char    *bins[TCACHE_COUNT];
+    uint16_t counts[TCACHE_COUNT];
+    unsigned generation;
+    Arena   *arena;
+
+    unsigned long mallocs[MM_STATS_CLASSES];
+    unsigned long frees[MM_STATS_CLASSES];
+#if MM_PROFILE
+    unsigned long lat_hist[LAT_KINDS][LAT_BUCKETS];
+#endif
+    ThreadCache  *stats_next;
+    ThreadCache  *stats_prev;
+};
+static thread_local ThreadCache tcache;
+
+/*
+ * Registry of thread caches for mm_get_stats, and the counts of threads
+ * that have exited since mm_init. All guarded by stats_lock.
+ */
+static std::mutex    stats_lock;
+static ThreadCache  *stats_threads = nullptr;
+static unsigned long retired_mallocs[MM_STATS_CLASSES];
+static unsigned long retired_frees[MM_STATS_CLASSES];
+#if MM_PROFILE
+static unsigned long retired_lat[LAT_KINDS][LAT_BUCKETS];
+#endif
+
+/* Thread-exit hook that hands a dying thread's cached blocks back */
+static pthread_key_t  tcache_key;
+static pthread_once_t tcache_key_once = PTHREAD_ONCE_INIT;
+
+/* ============================================
+ * Helper Function Prototypes
+ * ============================================ */
+
+static void *extend_heap(Arena *ar, size_t words, bool tail_only);
+static void  arena_reset(Arena *ar);
+static Arena *arena_of(const void *bp);
+static bool  is_slab(const void *bp);
+static bool  is_mmapped(const void *bp);
+static bool  wants_mapping(size_t size);
+static void *mmap_malloc(size_t size);
+static void *mmap_realloc(void *bp, size_t size);
+static void  mmap_free(void *bp);
+static int   slab_class(size_t size);
+static SlabRun *slab_run_of(const void *bp);
+static SlabRun *slab_new_run(Arena *ar);
+static void  slab_run_init(SlabRun *run, int cls);
+static void *slab_malloc_locked(Arena *ar, int cls);
+static void  slab_free_locked(Arena *ar, void *bp);
+static void  remote_free_push(Arena *ar, void *bp);
+static void  remote_free_drain(Arena *ar);
+static void *coalesce(Arena *ar, void *bp);
+static void  zero_seam(char *bp);
+static void  zero_bytes(void *p, size_t n);
+static void  arena_trim(Arena *ar, void *bp);
+static void  arena_purge(Arena *ar);
+static void *find_fit(Arena *ar, size_t asize);
+static bool  place(Arena *ar, void *bp, size_t asize);
+static size_t adjust_size(size_t size);
+static bool  resize_in_place(Arena *ar, void *bp, size_t asize);
+static void  add_to_free_list(Arena *ar, void *bp);
+static void  remove_from_free_list(Arena *ar, void *bp);
+static void  mapping_insert(size_t size, int *fl, int *sl);
+static void *find_suitable_bin(Arena *ar, int fl, int sl);
+static bool  tree_before(const char *a, const char *b);
+static uint64_t tree_priority(const char *bp);
+static void  tree_update(char *t);
+static void  tree_split(char *t, char *key, char **left, char **right);
+static char *tree_merge(char *left, char *right);
+static char *tree_insert(char *t, char *bp);
+static char *tree_remove(char *t, char *bp);
+static char *tree_first_fit(char *t, size_t asize, int *visited);
+static char *tree_best_fit(char *t, size_t asize, int *visited);
+static char *tree_leftmost(char *t, int *visited);
+template <typename F> static void tree_walk(char *t, size_t min_size, F &fn);
+template <typename F> static void for_each_free_block(Arena *ar, size_t min_size, F fn);
+static bool  quick_push(Arena *ar, void *bp, size_t size);
+static void *quick_pop(Arena *ar, size_t asize);
+static void  quick_release(Arena *ar, void *bp);
+static bool  flush_quick_lists(Arena *ar);
+static void *malloc_locked(Arena *ar, size_t asize, bool *zeroed);
+static void *memalign_locked(Arena *ar, size_t alignment, size_t asize);
+static void  free_locked(Arena *ar, void *bp);
+static ThreadCache *tcache_ready(void);
+static void *tcache_refill(ThreadCache *tc, int idx);
+static void  tcache_spill(ThreadCache *tc, int idx, int keep);
+static void  tcache_thread_exit(void *arg);
+static int   stats_class(size_t usable);
+static void  stats_resize(size_t old_usable, size_t new_usable);
+static void  touch_forget(Arena *ar, const char *bp, size_t size);
+static uint32_t block_seal(const void *bp, size_t size);
+static uint64_t mmap_seal(const void *bp, size_t len);
+[[noreturn]] static void harden_fail(const char *what, const void *bp);
+static char *harden_link(void *link);
+static void  harden_check(void *ptr);
+static void  harden_park(void *bp);
+static int   check_fail(const char *what, const void *bp);
+static bool  check_owned(const Arena *ar, const void *p);
+static int   check_free_entry(Arena *ar, char *bp, int fl, int sl);
+static int   check_tree(Arena *ar, char *t, int fl, int sl, const char *lo, const char *hi,
+                        size_t *count);
+static int   check_free_lists(Arena *ar, size_t *count);
+static int   check_regions(char *lo, char *hi, size_t *nfree);
+static int   check_slab_run(const SlabRun *run);
+static int   check_slab_lists(Arena *ar);
+static bool  check_listed(Arena *ar, char *bp);
+static int   check_touched(Arena *ar, char *bp);
+#if MM_PROFILE
+static uint64_t cycle_count(void);
+static int   lat_bucket(uint64_t ticks);
+static uint64_t lat_bucket_max(int bucket);
+static int   profile_percentile(const unsigned long *hist, int n, unsigned long total, double q);
+
+/*
+ * Times its own lifetime with the cycle counter and records it in the
+ * calling thread's latency histogram; declared by PROFILE_LATENCY.
+ */
+struct LatencyTimer {
+    int      kind;
+    uint64_t start;
+
+    explicit LatencyTimer(int k) : kind(k), start(cycle_count()) {}
+    ~LatencyTimer() {
+        int bucket = lat_bucket(cycle_count() - start);  /* STAT_INC reads its operand twice */
+        STAT_INC(tcache.lat_hist[kind][bucket]);
+    }
+};
+#endif
+
+/* ============================================
+ * Main Allocator Functions
+ * ============================================ */
+
+/*
+ * mm_init - Initialize the memory allocator.
+ *
+ * Steps:
+ * 1. Pick the number of arenas (MM_ARENAS, else 2 x online CPUs) and
+ *    reset every arena to empty. Read the mapping threshold
+ *    (MM_MMAP_THRESHOLD, else MMAP_THRESHOLD_DEFAULT; 0 disables it)
+ *    and the fit policy (MM_FIT_POLICY: "best", the default, "lifo" or
+ *    "address").
+ * 2. Map a zeroed page map covering all of memlib's possible heap.
+ * 3. Give arena 0 its first region, with one CHUNKSIZE-page free block
+ *    (see extend_heap for the region layout). The other arenas create
+ *    their first region on their first miss.
+ * 4. In hardened mode, draw a fresh harden_key. Only a heap that memlib
+ *    has just mapped counts as zero for mm_calloc.
+ * 5. Zero the statistics of every thread, then bump heap_generation so
+ *    every thread's tcache is treated as stale and threads are rebound
+ *    to the new arenas.
+ *
+ * Must not run concurrently with any other mm_* call.
+ *
+ * Return: 0 on success, -1 on error.
+ */
+int mm_init(void) {
+    pthread_once(&tcache_key_once, [] {
+        pthread_key_create(&tcache_key, tcache_thread_exit);
+    });
+
+    const char *env = getenv("MM_ARENAS");
+    long n = (env != nullptr) ? strtol(env, nullptr, 10) : 2 * sysconf(_SC_NPROCESSORS_ONLN);
+    narenas = static_cast<int>(n < 1 ? 1 : (n > MAX_ARENAS ? MAX_ARENAS : n));
+    for (int i = 0; i < MAX_ARENAS; ++i) arena_reset(&arenas[i]);
+
+    env = getenv("MM_MMAP_THRESHOLD");
+    mmap_threshold = (env != nullptr) ? strtoull(env, nullptr, 10) : MMAP_THRESHOLD_DEFAULT;
+    if (mmap_threshold == 0) mmap_threshold = SIZE_MAX;
+
+    if (HARDEN && getentropy(&harden_key, sizeof(harden_key)) != 0)
+        harden_key = (uint64_t)time(nullptr) * 0x9e3779b97f4a7c15ULL ^ (uintptr_t)&harden_key;
+    harden_key |= 1;
+
+    env = getenv("MM_FIT_POLICY");
+    if (env != nullptr && strcmp(env, "address") == 0)   fit_policy = FIT_ADDRESS;
+    else if (env != nullptr && strcmp(env, "lifo") == 0) fit_policy = FIT_LIFO;
+    else                                                 fit_policy = FIT_BEST;
+
+    /* Fresh anonymous pages are zero, so remapping also clears the map */
+    if (page_owner != nullptr) munmap(page_owner, page_owner_len);
+    page_owner_len = (mem_maxheap() >> PAGE_SHIFT) + 1;
+    page_owner = static_cast<uint8_t *>(mmap(nullptr, page_owner_len, PROT_READ | PROT_WRITE,
+                                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (page_owner == MAP_FAILED) { page_owner = nullptr; return -1; }
+    heap_base = static_cast<char *>(mem_heap_lo());
+    heap_fresh = (mem_heapsize() == 0) ? heap_base : heap_base + mem_maxheap();
+    extend_heap_calls = 0;
+
+    /* Arena 0's first region, exactly one page including the framing */
+    if (extend_heap(&arenas[0], (CHUNKSIZE - REGION_OVERHEAD) / WSIZE, false) == nullptr)
+        return -1;
+
+    {
+        std::lock_guard<std::mutex> guard(stats_lock);
+        memset(retired_mallocs, 0, sizeof(retired_mallocs));
+        memset(retired_frees, 0, sizeof(retired_frees));
+#if MM_PROFILE
+        memset(retired_lat, 0, sizeof(retired_lat));
+#endif
+        for (ThreadCache *tc = stats_threads; tc != nullptr; tc = tc->stats_next) {
+            memset(tc->mallocs, 0, sizeof(tc->mallocs));
+            memset(tc->frees, 0, sizeof(tc->frees));
+#if MM_PROFILE
+            memset(tc->lat_hist, 0, sizeof(tc->lat_hist));
+#endif
+        }
+    }
+
+    heap_generation.fetch_add(1, std::memory_order_release);
+    return 0;
+}
+
+/*
+ * mm_malloc - Allocate a block with at least size bytes of payload.
+ *
+ * Steps:
+ * 1. Return nullptr for size == 0. Sizes of mmap_threshold or more, and
+ *    any too big for a region (HEAP_REQUEST_MAX), are handed to
+ *    mmap_malloc and never touch the heap.
+ * 2. Compute the adjusted size asize that includes the header overhead
+ *    and satisfies alignment (adjust_size). Allocated blocks have no
+ *    footer, so only ALLOC_OVERHEAD (the header, plus the seal in
+ *    hardened mode) is added, but the block must still be able to hold
+ *    a free block's links and footer once it is freed:
+ *      asize = max(MIN_BLOCK_SIZE,
+ *                  ALIGNMENT * ((size + ALLOC_OVERHEAD + ALIGNMENT-1) / ALIGNMENT))
+ *    Sizes up to SLAB_MAX_SIZE skip this: they get a headerless slab
+ *    slot of their size class instead.
+ * 3. Slab classes and small blocks: pop the calling thread's tcache bin
+ *    without locking; on a miss, refill the bin from the thread's arena.
+ * 4. Everything else: lock the thread's arena and run malloc_locked.
+ * 5. Count the allocation in the thread's statistics.
+ *
+ * Return: pointer to allocated payload, or nullptr on failure.
+ */
+void *mm_malloc(size_t size) {
+    if (size == 0) return nullptr;
+    PROFILE_LATENCY(LAT_MALLOC);
+
+    ThreadCache *tc = tcache_ready();
+    char        *bp;
+    int          idx;
+
+    if (wants_mapping(size)) {
+        if ((bp = (char*)mmap_malloc(size)) != nullptr) {
+            STAT_INC(tc->mallocs[stats_class(MMAP_LEN(bp) - MMAP_OVERHEAD)]);
+        }
+        return bp;
+    }
+
+    if (size <= SLAB_MAX_SIZE) {
+        idx = slab_class(size);
+    } else {
+        /* Adjust block size to include overhead and alignment requirements */
+        size_t asize = adjust_size(size);
+        if (asize > TCACHE_MAX_SIZE) {
+            Arena *ar = tc->arena;
+            {
+                std::lock_guard<std::mutex> guard(ar->lock);
+                bp = (char*)malloc_locked(ar, asize, nullptr);
+            }
+            if (bp != nullptr) {
+                STAT_INC(tc->mallocs[stats_class(GET_SIZE_RELAXED(HDRP(bp)) - ALLOC_OVERHEAD)]);
+            }
+            return bp;
+        }
+        idx = SLAB_COUNT + static_cast<int>((asize - TCACHE_MIN_SIZE) / ALIGNMENT);
+    }
+
+    if ((bp = tc->bins[idx]) != nullptr) {
+        tc->bins[idx] = harden_link(GET_NEXT_FREE(bp));
+        --tc->counts[idx];
+        if (HARDEN) SET_PREV_FREE(bp, nullptr);     /* No longer parked */
+    } else if ((bp = (char*)tcache_refill(tc, idx)) == nullptr) {
+        return nullptr;
+    }
+
+    STAT_INC(tc->mallocs[idx < SLAB_COUNT ? idx : stats_class(GET_SIZE_RELAXED(HDRP(bp)) - ALLOC_OVERHEAD)]);
+    return bp;
+}
+
+/*
+ * mm_calloc - Allocate zeroed space for nmemb elements of size bytes.
+ *
+ * Steps:
+ * 1. Return nullptr if nmemb * size overflows or is 0.
+ * 2. Sizes that mm_malloc serves from a mapping or the tcache go through
+ *    mm_malloc. Mappings are fresh anonymous pages and stay as they are;
+ *    slab slots and tcache blocks are cleared in full.
+ * 3. Larger heap blocks come from malloc_locked, as in mm_malloc. If the
+ *    block was carved from a known-zero free block, only the free-block
+ *    node at its start and, outside hardened mode, its last word (an old
+ *    footer, or zero already) are cleared; else the whole request is.
+ *
+ * Return: pointer to the zeroed payload, or nullptr on failure.
+ */
+void *mm_calloc(size_t nmemb, size_t size) {
+    size_t bytes;
+    if (__builtin_mul_overflow(nmemb, size, &bytes) || bytes == 0) return nullptr;
+
+    char *bp;
+    if (wants_mapping(bytes) || bytes <= SLAB_MAX_SIZE || adjust_size(bytes) <= TCACHE_MAX_SIZE) {
+        if ((bp = (char*)mm_malloc(bytes)) != nullptr && !is_mmapped(bp)) zero_bytes(bp, bytes);
+        return bp;
+    }
+
+    PROFILE_LATENCY(LAT_MALLOC);
+    ThreadCache *tc = tcache_ready();
+    Arena       *ar = tc->arena;
+    bool         zeroed;
+    {
+        std::lock_guard<std::mutex> guard(ar->lock);
+        bp = (char*)malloc_locked(ar, adjust_size(bytes), &zeroed);
+    }
+    if (bp == nullptr) return nullptr;
+    STAT_INC(tc->mallocs[stats_class(GET_SIZE_RELAXED(HDRP(bp)) - ALLOC_OVERHEAD)]);
+
+    if (zeroed) {
+        memset(bp, 0, TREE_NODE_SIZE);
+        if (!HARDEN) PUT(FTRP(bp), 0);
+    } else {
+        zero_bytes(bp, bytes);
+    }
+    return bp;
+}
+
+/*
+ * mm_memalign - Allocate size bytes whose address is a multiple of
+ * alignment, a power of two.
+ *
+ * Steps:
+ * 1. Return nullptr for size == 0, an alignment that is not a power of
+ *    two, or a request too big for a block header.
+ * 2. If mm_malloc's block is aligned anyway, use it: every block is
+ *    ALIGNMENT-aligned, and slab slots and mapped blocks SLAB_ALIGN-aligned.
+ * 3. Otherwise lock the thread's arena and run memalign_locked, which
+ *    splits the unaligned head off a free block instead of padding it.
+ * 4. Count the allocation in the thread's statistics.
+ *
+ * Aligned blocks always come from the heap, never from a mapping; they
+ * are freed and reallocated like any other block.
+ *
+ * Return: pointer to the aligned payload, or nullptr on failure.
+ */
+void *mm_memalign(size_t alignment, size_t size) {
+    if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) return nullptr;
+    if (size > HEAP_REQUEST_MAX / 2 || alignment > HEAP_REQUEST_MAX / 2) return nullptr;
+    static_assert(MMAP_OVERHEAD % SLAB_ALIGN == 0, "mapped blocks are SLAB_ALIGN-aligned");
+    if (alignment <= ALIGNMENT ||
+        (alignment <= SLAB_ALIGN && (size <= SLAB_MAX_SIZE || wants_mapping(size))))
+        return mm_malloc(size);
+
+    PROFILE_LATENCY(LAT_MALLOC);
+    ThreadCache *tc = tcache_ready();
+    Arena       *ar = tc->arena;
+    char        *bp;
+    {
+        std::lock_guard<std::mutex> guard(ar->lock);
+        bp = (char*)memalign_locked(ar, alignment, adjust_size(size));
+    }
+    if (bp != nullptr) {
+        STAT_INC(tc->mallocs[stats_class(GET_SIZE_RELAXED(HDRP(bp)) - ALLOC_OVERHEAD)]);
+    }
+    return bp;
+}
+
+/*
+ * mm_aligned_alloc - C11 aligned_alloc: the same as mm_memalign.
+ *
+ * Return: pointer to the aligned payload, or nullptr on failure.
+ */
+void *mm_aligned_alloc(size_t alignment, size_t size) {
+    return mm_memalign(alignment, size);
+}
+
+/*
+ * malloc_locked - Allocate an asize-byte block from arena ar.
+ *
+ * Caller holds ar->lock.
+ *
+ * Steps:
+ * 1. Drain blocks other threads have freed into this arena, so they are
+ *    back in the free lists before the search.
+ * 2. In deferred-coalescing mode, reuse a parked block of exactly asize
+ *    from the quick lists if there is one.
+ * 3. Search free list: bp = find_fit(ar, asize).
+ *    If found, call place(ar, bp, asize) and return bp.
+ *    On a miss in deferred mode, coalesce all parked blocks and retry.
+ * 4. If not found, extend heap by max(asize, CHUNKSIZE), place, return.
+ *    Return nullptr if extend_heap fails.
+ *
+ * If zeroed is not null, *zeroed tells whether the block was carved from
+ * a known-zero free block (see place).
+ *
+ * Return: pointer to allocated payload, or nullptr on failure.
+ */
+static void *malloc_locked(Arena *ar, size_t asize, bool *zeroed) {
+    size_t extendsize;
+    char *bp;
+    bool  zero;
+
+    if (zeroed != nullptr) *zeroed = false;
+
+    if (ar->remote_frees.load(std::memory_order_relaxed) != nullptr) {
+        remote_free_drain(ar);
+    }
+
+    /* Parked blocks are still marked allocated: hand one back as is */
+    if (DEFER_COALESCE && (bp = (char*)quick_pop(ar, asize)) != nullptr) {
+        return bp;
+    }
+
+    /* Search the free list for a fit, merging parked blocks on a miss */
+    if ((bp = (char*)find_fit(ar, asize)) != nullptr ||
+        (DEFER_COALESCE && flush_quick_lists(ar) &&
+         (bp = (char*)find_fit(ar, asize)) != nullptr)) {
+        zero = place(ar, bp, asize);
+        if (zeroed != nullptr) *zeroed = zero;
+        return bp;
+    }
+
+    /* No fit found. Get more memory and place the block */
+    extendsize = (asize > CHUNKSIZE) ? asize : CHUNKSIZE;
+    if ((bp = (char*)extend_heap(ar, extendsize / WSIZE, false)) == nullptr) return nullptr;
+    
+    zero = place(ar, bp, asize);
+    if (zeroed != nullptr) *zeroed = zero;
+    return bp;
+}
+
+/*
+ * memalign_locked - Allocate an asize-byte block from arena ar whose
+ * payload is a multiple of alignment (a power of two above ALIGNMENT).
+ *
+ * Caller holds ar->lock.
+ *
+ * Steps:
+ * 1. Drain remote frees and find a free block of at least
+ *    asize + alignment + MIN_BLOCK_SIZE bytes, as malloc_locked does
+ *    (merging parked blocks or extending the heap on a miss). Any block
+ *    that large has an aligned payload address ap past which asize bytes
+ *    fit, with either ap == bp or a gap of at least MIN_BLOCK_SIZE.
+ * 2. If ap != bp, cut the block at ap into two free blocks: the head
+ *    [bp, ap) keeps bp's prev-allocated bit, ap's block follows a free
+ *    block. Both keep bp's ZERO_BIT and purge state, since the new
+ *    boundary words lie inside bp. Neither can merge with a neighbor:
+ *    bp had none free.
+ * 3. place(ar, ap, asize), which splits off the tail as usual.
+ *
+ * Return: pointer to the aligned payload, or nullptr on failure.
+ */
+static void *memalign_locked(Arena *ar, size_t alignment, size_t asize) {
+    size_t want = asize + alignment + MIN_BLOCK_SIZE;
+    char  *bp;
+
+    if (ar->remote_frees.load(std::memory_order_relaxed) != nullptr) {
+        remote_free_drain(ar);
+    }
+
+    if ((bp = (char*)find_fit(ar, want)) == nullptr &&
+        !(DEFER_COALESCE && flush_quick_lists(ar) &&
+          (bp = (char*)find_fit(ar, want)) != nullptr)) {
+        size_t extendsize = (want > CHUNKSIZE) ? want : CHUNKSIZE;
+        if ((bp = (char*)extend_heap(ar, extendsize / WSIZE, false)) == nullptr) return nullptr;
+    }
+
+    char *ap = (char*)(((uintptr_t)bp + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    if (ap != bp) {
+        if ((size_t)(ap - bp) < MIN_BLOCK_SIZE) ap += alignment;
+
+        size_t       csize  = GET_SIZE(HDRP(bp));
+        size_t       lead   = (size_t)(ap - bp);
+        word_t       zero   = GET_ZERO(HDRP(bp));
+        word_t       purged = GET_PURGE_BITS(FTRP(bp));
+        remove_from_free_list(ar, bp);
+        PUT(HDRP(bp), PACK(lead, GET_PREV_ALLOC(HDRP(bp)), 0) | zero);
+        PUT(FTRP(bp), PACK(lead, 0, 0) | purged);
+        PUT(HDRP(ap), PACK(csize - lead, 0, 0) | zero);
+        PUT(FTRP(ap), PACK(csize - lead, 0, 0) | purged);
+        add_to_free_list(ar, bp);
+        add_to_free_list(ar, ap);
+    }
+
+    place(ar, ap, asize);
+    return ap;
+}
+
+/*
+ * mm_free - Free a previously allocated block.
+ *
+ * Steps:
+ * 1. Return immediately if ptr == nullptr. In hardened mode, abort
+ *    unless ptr is an allocated block (harden_check). Unmap mapped
+ *    blocks at once.
+ * 2. If the page map says ptr lies in a slab run, its tcache bin is the
+ *    run's size class. Otherwise read the block size from the header.
+ *    Only the size bits are used; a neighbor may concurrently flip the
+ *    prev-allocated bit under its arena lock, but the size of an
+ *    allocated block never changes.
+ * 3. Slab slots and small blocks go on the calling thread's tcache bin
+ *    without locking. A full bin first spills half of its blocks to their
+ *    owning arenas.
+ * 4. Everything else goes to the arena that owns ptr (looked up in the
+ *    page map): the caller's own arena is locked and free_locked runs;
+ *    any other arena gets ptr on its remote-free stack, lock-free.
+ *
+ * Every path counts the free in the thread's statistics first.
+ *
+ * Return: nothing.
+ */
+void mm_free(void *ptr) {
+    if (ptr == nullptr) return;
+    PROFILE_LATENCY(LAT_FREE);
+
+    if (HARDEN) harden_check(ptr);
+    ThreadCache *tc = tcache_ready();
+
+    if (is_mmapped(ptr)) {
+        STAT_INC(tc->frees[stats_class(MMAP_LEN(ptr) - MMAP_OVERHEAD)]);
+        mmap_free(ptr);
+        return;
+    }
+
+    int idx;
+
+    if (is_slab(ptr)) {
+        idx = slab_run_of(ptr)->cls;
+        STAT_INC(tc->frees[idx]);
+    } else {
+        size_t size = GET_SIZE_RELAXED(HDRP(ptr));
+        STAT_INC(tc->frees[stats_class(size - ALLOC_OVERHEAD)]);
+        if (size < TCACHE_MIN_SIZE || size > TCACHE_MAX_SIZE) {
+            Arena *ar = arena_of(ptr);
+            if (ar != tc->arena) {
+                remote_free_push(ar, ptr);
+                return;
+            }
+
+            std::lock_guard<std::mutex> guard(ar->lock);
+            free_locked(ar, ptr);
+            return;
+        }
+        idx = SLAB_COUNT + static_cast<int>((size - TCACHE_MIN_SIZE) / ALIGNMENT);
+    }
+
+    if (tc->counts[idx] >= TCACHE_BIN_MAX) tcache_spill(tc, idx, TCACHE_BIN_MAX / 2);
+    SET_NEXT_FREE(ptr, tc->bins[idx]);
+    harden_park(ptr);
+    tc->bins[idx] = (char*)ptr;
+    ++tc->counts[idx];
+}
+
+/*
+ * free_locked - Return an allocated block to its owning arena ar.
+ *
+ * Caller holds ar->lock.
+ *
+ * Steps:
+ * 1. Slab slots have no header: hand them to slab_free_locked().
+ * 2. In deferred-coalescing mode, park blocks of a quick-list size
+ *    and return; they are merged later by flush_quick_lists().
+ * 3. Clear the allocated bit in the header and write a footer
+ *    (allocated blocks have none).
+ * 4. Call coalesce(ar, bp).
+ * 5. Give memory back: trim the heap if the merged block is large and
+ *    ends at the epilogue, and purge the arena once enough was freed.
+ *
+ * IMPORTANT: Do NOT call add_to_free_list() here.
+ * coalesce() handles adding the final merged block to the free list.
+ * Calling add_to_free_list() in both places would insert the block
+ * twice and silently corrupt the list.
+ *
+ * Return: nothing.
+ */
+static void free_locked(Arena *ar, void *bp) {
+    if (HARDEN) SET_PREV_FREE(bp, nullptr);         /* No longer parked */
+    if (is_slab(bp)) {
+        slab_free_locked(ar, bp);
+        return;
+    }
+
+    size_t size = GET_SIZE(HDRP(bp));
+
+    if (DEFER_COALESCE && quick_push(ar, bp, size)) return;
+
+    /* coalesce() clears the next block's prev-allocated bit */
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)), 0));
+    PUT(FTRP(bp), PACK(size, 0, 0));
+    bp = coalesce(ar, bp);
+
+    if (GET_SIZE(HDRP(bp)) >= ar->trim_threshold && GET_SIZE(HDRP(NEXT_BLKP(bp))) == 0) {
+        arena_trim(ar, bp);
+    }
+    if ((ar->dirty_bytes += size) >= PURGE_THRESHOLD) {
+        arena_purge(ar);
+    }
+}
+
+/*
+ * mm_realloc - Resize a previously allocated block.
+ *
+ * A mapped block whose new size still wants a mapping (see
+ * wants_mapping) is resized with mmap_realloc, without copying.
+ * A slab slot stays put if the new size maps to the same size class.
+ * A heap block whose new size fits the heap tries resize_in_place()
+ * first, under the lock of the arena that owns ptr, which shrinks by
+ * splitting off the tail or grows into a free next block and/or the end
+ * of the arena's region. Only if that fails does it fall back to
+ * malloc + memcpy + free.
+ * Resizing in place moves the block between statistics classes.
+ *
+ * Return: pointer to resized block, or nullptr on failure.
+ */
+void *mm_realloc(void *ptr, size_t size) {
+    if (ptr == nullptr)   return mm_malloc(size);
+    if (size == 0)        { mm_free(ptr); return nullptr; }
+    if (HARDEN)           harden_check(ptr);
+
+    size_t copy_size;
+
+    if (is_mmapped(ptr)) {
+        copy_size = MMAP_LEN(ptr) - MMAP_OVERHEAD;
+        if (wants_mapping(size)) {
+            void *newptr = mmap_realloc(ptr, size);
+            if (newptr != nullptr) stats_resize(copy_size, MMAP_LEN(newptr) - MMAP_OVERHEAD);
+            return newptr;
+        }
+    } else if (is_slab(ptr)) {
+        int cls = slab_run_of(ptr)->cls;
+        if (size <= SLAB_MAX_SIZE && slab_class(size) == cls) return ptr;
+        copy_size = SLAB_SIZES[cls];
+    } else {
+        copy_size = GET_SIZE_RELAXED(HDRP(ptr)) - ALLOC_OVERHEAD;  /* payload only: subtract header */
+        if (!wants_mapping(size)) {
+            Arena *ar = arena_of(ptr);
+            bool   resized;
+            {
+                std::lock_guard<std::mutex> guard(ar->lock);
+                resized = resize_in_place(ar, ptr, adjust_size(size));
+            }
+            if (resized) {
+                stats_resize(copy_size, GET_SIZE_RELAXED(HDRP(ptr)) - ALLOC_OVERHEAD);
+                return ptr;
+            }
+        }
+    }
+
+    void *newptr = mm_malloc(size);
+    if (newptr == nullptr) return nullptr;
+
+    if (size < copy_size) copy_size = size;
+    memcpy(newptr, ptr, copy_size);
+    mm_free(ptr);
+    return newptr;
+}
+
+/*
+ * mm_usable_size - Bytes the caller may use at ptr, which can exceed
+ * what it asked for: a slab slot's whole class, a heap block's payload
+ * including split slack and rounding, or a mapping's whole pages.
+ *
+ * Return: the usable size, or 0 for nullptr.
+ */
+size_t mm_usable_size(void *ptr) {
+    if (ptr == nullptr) return 0;
+    if (HARDEN)         harden_check(ptr);
+
+    if (is_mmapped(ptr)) return MMAP_LEN(ptr) - MMAP_OVERHEAD;
+    if (is_slab(ptr))    return SLAB_SIZES[slab_run_of(ptr)->cls];
+    return GET_SIZE_RELAXED(HDRP(ptr)) - ALLOC_OVERHEAD;
+}
+
+/*
+ * mm_malloc_at_least - mm_malloc that also stores the block's usable
+ * size (see mm_usable_size) in *actual, or 0 on failure, so growable
+ * buffers can use the slack without asking again. actual may be nullptr.
+ *
+ * Return: pointer to allocated payload, or nullptr on failure.
+ */
+void *mm_malloc_at_least(size_t size, size_t *actual) {
+    void *bp = mm_malloc(size);
+    if (actual != nullptr) *actual = mm_usable_size(bp);
+    return bp;
+}
+
+/*
+ * mm_get_stats - Report allocator statistics (see struct mm_stats).
+ *
+ * Steps:
+ * 1. Sum the per-class counters of every registered thread and of the
+ *    threads that have exited, under stats_lock.
+ * 2. Read the heap size and extend_heap count under sbrk_lock.
+ * 3. Walk every arena's bins and slab runs under its lock to total the
+ *    free heap blocks and free slab slots.
+ * 4. Derive bytes_allocated and the external fragmentation ratio.
+ *
+ * The figures are gathered one lock at a time, so while other threads
+ * run they need not be mutually consistent.
+ *
+ * Return: nothing.
+ */
+void mm_get_stats(struct mm_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    for (int c = 0; c < MM_STATS_CLASSES; ++c) {
+        if (c < SLAB_COUNT)                 stats->class_max[c] = SLAB_SIZES[c];
+        else if (c < MM_STATS_CLASSES - 1)  stats->class_max[c] = size_t(1) << (STATS_LOG2_BASE + c - SLAB_COUNT);
+        else                                stats->class_max[c] = SIZE_MAX;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(stats_lock);
+        for (int c = 0; c < MM_STATS_CLASSES; ++c) {
+            stats->mallocs[c] = retired_mallocs[c];
+            stats->frees[c]   = retired_frees[c];
+        }
+        for (ThreadCache *tc = stats_threads; tc != nullptr; tc = tc->stats_next) {
+            for (int c = 0; c < MM_STATS_CLASSES; ++c) {
+                stats->mallocs[c] += __atomic_load_n(&tc->mallocs[c], __ATOMIC_RELAXED);
+                stats->frees[c]   += __atomic_load_n(&tc->frees[c], __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(sbrk_lock);
+        stats->heap_size         = mem_heapsize();
+        stats->extend_heap_calls = extend_heap_calls;
+    }
+
+    size_t heap_free = 0;
+    for (int i = 0; i < narenas; ++i) {
+        Arena *ar = &arenas[i];
+        std::lock_guard<std::mutex> guard(ar->lock);
+
+        for_each_free_block(ar, 0, [&](char *bp) {
+            size_t size = GET_SIZE(HDRP(bp));
+            heap_free += size;
+            ++stats->free_blocks;
+            if (size > stats->largest_free) stats->largest_free = size;
+        });
+        for (int cls = 0; cls < SLAB_COUNT; ++cls) {
+            for (SlabRun *run = ar->slab_partial[cls]; run != nullptr; run = run->next) {
+                stats->bytes_free += size_t(run->nfree) * SLAB_SIZES[cls];
+            }
+        }
+        for (SlabRun *run = ar->slab_empty; run != nullptr; run = run->next) {
+            stats->bytes_free += CHUNKSIZE - SLAB_HDR_SIZE;
+        }
+    }
+
+    stats->bytes_free     += heap_free;
+    stats->mapped_bytes    = mapped_bytes.load(std::memory_order_relaxed);
+    stats->bytes_allocated = stats->heap_size - stats->bytes_free + stats->mapped_bytes;
+    stats->fragmentation   = heap_free ? 1.0 - double(stats->largest_free) / double(heap_free) : 0.0;
+}
+
+/*
+ * mm_get_profile - Report the search-length and latency profile (see
+ * struct mm_profile).
+ *
+ * Steps:
+ * 1. Sum the latency histograms of every registered thread and of the
+ *    threads that have exited, under stats_lock.
+ * 2. Sum every arena's find_fit histogram under its lock.
+ * 3. Read the percentiles off the merged histograms.
+ *
+ * Return: 0, or -1 (with *prof zeroed) if built without MM_PROFILE.
+ */
+int mm_get_profile(struct mm_profile *prof) {
+    memset(prof, 0, sizeof(*prof));
+#if MM_PROFILE
+    unsigned long lat[LAT_KINDS][LAT_BUCKETS];
+    unsigned long calls[LAT_KINDS] = {};
+
+    {
+        std::lock_guard<std::mutex> guard(stats_lock);
+        memcpy(lat, retired_lat, sizeof(lat));
+        for (ThreadCache *tc = stats_threads; tc != nullptr; tc = tc->stats_next) {
+            for (int k = 0; k < LAT_KINDS; ++k) {
+                for (int b = 0; b < LAT_BUCKETS; ++b)
+                    lat[k][b] += __atomic_load_n(&tc->lat_hist[k][b], __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    for (int i = 0; i < narenas; ++i) {
+        std::lock_guard<std::mutex> guard(arenas[i].lock);
+        for (int n = 0; n < MM_FIT_BUCKETS; ++n) prof->fit_nodes[n] += arenas[i].fit_hist[n];
+    }
+
+    for (int n = 0; n < MM_FIT_BUCKETS; ++n) prof->fit_calls += prof->fit_nodes[n];
+    for (int k = 0; k < LAT_KINDS; ++k) {
+        for (int b = 0; b < LAT_BUCKETS; ++b) calls[k] += lat[k][b];
+    }
+
+    auto fit = [&](double q) -> unsigned long {
+        return profile_percentile(prof->fit_nodes, MM_FIT_BUCKETS, prof->fit_calls, q);
+    };
+    auto cycles = [&](int kind, double q) -> unsigned long {
+        return lat_bucket_max(profile_percentile(lat[kind], LAT_BUCKETS, calls[kind], q));
+    };
+
+    prof->fit_p50      = fit(0.50);
+    prof->fit_p99      = fit(0.99);
+    prof->fit_p999     = fit(0.999);
+    prof->malloc_calls = calls[LAT_MALLOC];
+    prof->malloc_p50   = cycles(LAT_MALLOC, 0.50);
+    prof->malloc_p99   = cycles(LAT_MALLOC, 0.99);
+    prof->malloc_p999  = cycles(LAT_MALLOC, 0.999);
+    prof->free_calls   = calls[LAT_FREE];
+    prof->free_p50     = cycles(LAT_FREE, 0.50);
+    prof->free_p99     = cycles(LAT_FREE, 0.99);
+    prof->free_p999    = cycles(LAT_FREE, 0.999);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/* ============================================
+ * Helper Functions
+ * ============================================ */
+
+/*
+ * heap_sbrk - mem_sbrk for an increment of any size. memlib takes an
+ * int, so a larger one is taken in pieces, which are contiguous because
+ * the caller holds sbrk_lock. If a piece fails, the ones already taken
+ * are given back.
+ *
+ * Return: start of the new memory, or nullptr.
+ */
+static char *heap_sbrk(size_t incr) {
+    constexpr size_t STEP = INT_MAX & ~(CHUNKSIZE - 1);
+    char  *base  = nullptr;
+    size_t taken = 0;
+
+    while (taken < incr) {
+        size_t step = incr - taken < STEP ? incr - taken : STEP;
+        char  *p    = (char*)mem_sbrk(static_cast<int>(step));
+        if ((long)p == -1) {
+            for (; taken > 0; taken -= step) {
+                step = taken < STEP ? taken : STEP;
+                mem_sbrk(-static_cast<int>(step));
+            }
+            return nullptr;
+        }
+        if (base == nullptr) base = p;
+        taken += step;
+    }
+    return base;
+}
+
+/*
+ * extend_heap - Give arena ar a new free block of at least words * WSIZE
+ * bytes.
+ *
+ * Memory is taken with heap_sbrk in whole CHUNKSIZE pages, under sbrk_lock.
+ *
+ * If the arena's newest region ends at the current break, that region
+ * simply grows: the new block's header overwrites the old epilogue
+ * (keeping its prev-allocated bit) and a new epilogue goes at the end,
+ * exactly as with a single heap.
+ *
+ * Otherwise another arena has grown in between, or growing would take
+ * the region past MAX_REGION_SIZE, so a new region is started with its
+ * own sentinels, laid out like this (offsets double with 8-byte words):
+ *
+ *   Offset:  0      4      8      12     16
+ *            +------+------+------+------+--------- ... ---+------+
+ *   Content: | Pad  |ProHdr|ProFtr|BlkHdr| free block ...   |EpiHdr|
+ *            |  0   | 8|1  | 8|1  |      |                  |  0|1 |
+ *            +------+------+------+------+--------- ... ---+------+
+ *                          ^             ^
+ *           region prologue payload      bp (first block payload)
+ *
+ * The prologue stops coalesce() from merging past the region start and
+ * the epilogue stops it at the region end. The first region's prologue
+ * payload becomes ar->heap_listp. Either way the new pages are recorded
+ * as owned by ar in the page map, and the new block is marked known-zero
+ * if its pages lie above heap_fresh.
+ *
+ * With tail_only set, no new region is started: the call fails unless
+ * the arena's newest region can grow in place (used by realloc).
+ *
+ * Return: pointer to the new free block (possibly merged), or nullptr.
+ */
+static void *extend_heap(Arena *ar, size_t words, bool tail_only) {
+    char *bp;
+    size_t size = (words % 2) ? (words + 1) * WSIZE : words * WSIZE;
+    bool   fresh;
+
+    {
+        std::lock_guard<std::mutex> guard(sbrk_lock);
+        ++extend_heap_calls;
+
+        size_t incr = (size + CHUNKSIZE - 1) & ~(CHUNKSIZE - 1);
+        bool   grow = ar->region_end != nullptr &&
+                      ar->region_end == (char*)mem_heap_hi() + 1 &&
+                      incr <= MAX_REGION_SIZE - (size_t)(ar->region_end - ar->region_start);
+        if (tail_only && !grow) return nullptr;
+
+        if (!grow) incr = (size + REGION_OVERHEAD + CHUNKSIZE - 1) & ~(CHUNKSIZE - 1);
+        if (incr > MAX_REGION_SIZE) return nullptr;
+
+        char *base = heap_sbrk(incr);
+        if (base == nullptr) return nullptr;
+
+        if (ar->trimmed) {                               /* Trimmed too eagerly */
+            ar->trimmed        = false;
+            if (ar->trim_threshold < TRIM_THRESHOLD_MAX) ar->trim_threshold *= 2;
+        }
+
+        if (grow) {
+            bp   = base;                                 /* Old epilogue is bp's header */
+            size = incr;
+        } else {
+            PUT(base, 0);                                /* Alignment padding */
+            PUT(base + (1 * WSIZE), PACK(DSIZE, 1, 1));  /* Prologue header */
+            PUT(base + (2 * WSIZE), PACK(DSIZE, 1, 1));  /* Prologue footer */
+            PUT(base + (3 * WSIZE), PACK(0, 1, 1));      /* Stand-in epilogue */
+            if (ar->heap_listp == nullptr) ar->heap_listp = base + (2 * WSIZE);
+            ar->region_start = base;
+            bp   = base + REGION_OVERHEAD;
+            size = incr - REGION_OVERHEAD;
+        }
+
+        memset(page_owner + ((base - heap_base) >> PAGE_SHIFT),
+               static_cast<int>(ar - arenas) + 1, incr >> PAGE_SHIFT);
+        ar->region_end = base + incr;
+        fresh = base >= heap_fresh;
+        if (base + incr > heap_fresh) heap_fresh = base + incr;
+    }
+
+    /* Initialize free block header/footer and the new epilogue header */
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));    /* From the old epilogue */
+    PUT(HDRP(bp), PACK(size, prev_alloc, 0) | (fresh ? ZERO_BIT : 0));  /* Free block header */
+    PUT(FTRP(bp), PACK(size, 0, 0));                 /* Free block footer */
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 0, 1));         /* New epilogue header */
+
+    /* Coalesce merges with previous if possible and adds to free list */
+    return coalesce(ar, bp);
+}
+
+/*
+ * arena_reset - Forget all of ar's regions and free blocks.
+ *
+ * Return: nothing.
+ */
+static void arena_reset(Arena *ar) {
+    ar->heap_listp   = nullptr;
+    ar->region_start = nullptr;
+    ar->region_end   = nullptr;
+    memset(ar->free_lists, 0, sizeof(ar->free_lists));
+    memset(ar->sl_bitmap, 0, sizeof(ar->sl_bitmap));
+    ar->fl_bitmap = 0;
+    ar->addr_tree = nullptr;
+    memset(ar->quick_lists, 0, sizeof(ar->quick_lists));
+    memset(ar->quick_counts, 0, sizeof(ar->quick_counts));
+    memset(ar->slab_partial, 0, sizeof(ar->slab_partial));
+    ar->slab_empty = nullptr;
+    ar->dirty_bytes    = 0;
+    ar->trim_threshold = TRIM_THRESHOLD;
+    ar->trimmed        = false;
+    memset(ar->touched, 0, sizeof(ar->touched));
+    ar->touch_next = 0;
+    ar->remote_frees.store(nullptr, std::memory_order_relaxed);
+#if MM_PROFILE
+    memset(ar->fit_hist, 0, sizeof(ar->fit_hist));
+#endif
+}
+
+/*
+ * arena_of - Look up the arena that owns the heap block or slab slot bp.
+ *
+ * Pages enter the map before any block in them is handed out, and a
+ * page never changes owner, so this needs no lock.
+ *
+ * Return: the owning arena.
+ */
+static Arena *arena_of(const void *bp) {
+    size_t page = static_cast<size_t>((const char*)bp - heap_base) >> PAGE_SHIFT;
+    return &arenas[(page_owner[page] & PAGE_ARENA_MASK) - 1];
+}
+
+/*
+ * is_slab - Tell whether bp is a slab slot rather than a heap block.
+ *
+ * Return: true if bp's page is a slab run.
+ */
+static bool is_slab(const void *bp) {
+    size_t page = static_cast<size_t>((const char*)bp - heap_base) >> PAGE_SHIFT;
+    return (page_owner[page] & PAGE_SLAB) != 0;
+}
+
+/*
+ * coalesce - Merge bp with any adjacent free blocks, then add to free list.
+ *
+ * Always call this immediately after marking a block free -- never call
+ * add_to_free_list() directly from mm_free().
+ *
+ * Four cases based on neighbor allocation status:
+ *   Case 1: prev alloc,  next alloc  -- no merge
+ *   Case 2: prev alloc,  next free   -- merge with next
+ *   Case 3: prev free,   next alloc  -- merge with prev
+ *   Case 4: prev free,   next free   -- merge with both
+ *
+ * For every block you absorb, call remove_from_free_list() BEFORE
+ * updating any sizes. Changing sizes first corrupts the list because
+ * removal relies on reading correct size/pointer fields.
+ *
+ * In cases 3 and 4, set bp = PREV_BLKP(bp) after merging so that bp
+ * refers to the start of the combined block when add_to_free_list is called.
+ *
+ * The previous block's allocation status comes from bp's own header
+ * (prev-allocated bit), not from its footer: allocated blocks have none.
+ * Once merged, the block after the result is told its predecessor is
+ * now free by clearing its prev-allocated bit.
+ *
+ * The result is known-zero only if every merged block was; the words
+ * between them are then cleared (zero_seam) so that it stays so.
+ *
+ * Hints:
+ *   int prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+ *   int next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+ *   size_t size    = GET_SIZE(HDRP(bp));
+ *
+ * Return: pointer to the (possibly enlarged) free block.
+ */
+static void *coalesce(Arena *ar, void *bp) {
+    // 1. Get allocation status of neighbors
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+    size_t size = GET_SIZE(HDRP(bp));
+    word_t zero = GET_ZERO(HDRP(bp));
+
+    // 2. Handle the 4 cases
+    if (prev_alloc && next_alloc) {            /* Case 1: Both allocated */
+        // Nothing to merge
+    } 
+    else if (prev_alloc && !next_alloc) {      /* Case 2: Merge with next */
+        char *next = NEXT_BLKP(bp);
+        remove_from_free_list(ar, next);
+        size += GET_SIZE(HDRP(next));
+        if ((zero &= GET_ZERO(HDRP(next)))) zero_seam(next);
+        PUT(HDRP(bp), PACK(size, 1, 0) | zero);
+        PUT(FTRP(bp), PACK(size, 0, 0));
+    } 
+    else if (!prev_alloc && next_alloc) {      /* Case 3: Merge with prev */
+        char *prev = PREV_BLKP(bp);
+        remove_from_free_list(ar, prev);
+        size += GET_SIZE(HDRP(prev));
+        if ((zero &= GET_ZERO(HDRP(prev)))) zero_seam((char*)bp);
+        PUT(HDRP(prev), PACK(size, GET_PREV_ALLOC(HDRP(prev)), 0) | zero);
+        PUT(FTRP(prev), PACK(size, 0, 0));
+        bp = prev;
+    } 
+    else {                                     /* Case 4: Merge both */
+        char *prev = PREV_BLKP(bp);
+        char *next = NEXT_BLKP(bp);
+        remove_from_free_list(ar, prev);
+        remove_from_free_list(ar, next);
+        size += GET_SIZE(HDRP(prev)) + GET_SIZE(HDRP(next));
+        if ((zero &= GET_ZERO(HDRP(prev)) & GET_ZERO(HDRP(next)))) {
+            zero_seam(next);
+            zero_seam((char*)bp);
+        }
+        PUT(HDRP(prev), PACK(size, GET_PREV_ALLOC(HDRP(prev)), 0) | zero);
+        PUT(FTRP(prev), PACK(size, 0, 0));
+        bp = prev;
+    }
+
+    // 3. The block after the merged one now follows a free block
+    CLR_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+    if (!(prev_alloc && next_alloc)) touch_forget(ar, (char*)bp, size);
+
+    // 4. Add the resulting block to the free list
+    add_to_free_list(ar, bp);
+    return bp;
+}
+
+/*
+ * zero_seam - Clear what separates the free block bp from the free block
+ * before it, which it is being merged into: the previous footer, bp's
+ * header and bp's free-list links or tree node. Both blocks must be off
+ * the free lists, and the merged header and footer written afterwards.
+ *
+ * Return: nothing.
+ */
+static void zero_seam(char *bp) {
+    memset(bp - DSIZE, 0, DSIZE + TREE_NODE_SIZE);
+}
+
+/*
+ * zero_bytes - Clear n bytes at p.
+ *
+ * From CALLOC_STREAM_MIN bytes up, and where SSE2 is available (always
+ * on x86-64), the aligned middle is cleared with 16-byte non-temporal
+ * stores, four per 64-byte line, which go straight to memory without
+ * first reading each line into the cache. The sfence orders them
+ * before any later store that publishes the block.
+ *
+ * Return: nothing.
+ */
+static void zero_bytes(void *p, size_t n) {
+#if defined(__SSE2__)
+    if (n >= CALLOC_STREAM_MIN) {
+        char  *c    = (char*)p;
+        size_t head = (0 - (uintptr_t)c) & 15;
+        memset(c, 0, head);
+        c += head;
+        n -= head;
+
+        const __m128i z = _mm_setzero_si128();
+        for (; n >= 64; c += 64, n -= 64) {
+            _mm_stream_si128((__m128i *)c, z);
+            _mm_stream_si128((__m128i *)(c + 16), z);
+            _mm_stream_si128((__m128i *)(c + 32), z);
+            _mm_stream_si128((__m128i *)(c + 48), z);
+        }
+        _mm_sfence();
+        memset(c, 0, n);
+        return;
+    }
+#endif
+    memset(p, 0, n);
+}
+
+/*
+ * arena_trim - Return the tail of the free block bp, which ends at an
+ * epilogue, to memlib.
+ *
+ * Only possible if bp's region is the arena's newest and still ends at
+ * the memlib break; checked under sbrk_lock. bp keeps one CHUNKSIZE page
+ * so that the next small request does not go straight back to mem_sbrk,
+ * and the released pages leave the page map. bp keeps its ZERO_BIT and
+ * purge state, and the arena is marked as having trimmed, so that
+ * extend_heap raises its trim threshold if the pages are wanted again.
+ *
+ * Return: nothing.
+ */
+static void arena_trim(Arena *ar, void *bp) {
+    std::lock_guard<std::mutex> guard(sbrk_lock);
+
+    if (NEXT_BLKP(bp) != ar->region_end || ar->region_end != (char*)mem_heap_hi() + 1) return;
+
+    size_t size    = GET_SIZE(HDRP(bp));
+    size_t release = (size - CHUNKSIZE) & ~(CHUNKSIZE - 1);
+    if (release > static_cast<size_t>(INT_MAX)) release = INT_MAX & ~(CHUNKSIZE - 1);
+    if (release == 0) return;
+
+    remove_from_free_list(ar, bp);
+    size -= release;
+    word_t purged = GET_PURGE_BITS(FTRP(bp));
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)), 0) | GET_ZERO(HDRP(bp)));
+    PUT(FTRP(bp), PACK(size, 0, 0) | purged);
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 0, 1));         /* New epilogue header */
+    add_to_free_list(ar, bp);
+
+    ar->trimmed     = true;
+    ar->region_end -= release;
+    memset(page_owner + ((ar->region_end - heap_base) >> PAGE_SHIFT), 0, release >> PAGE_SHIFT);
+    mem_sbrk(-static_cast<int>(release));
+}
+
+/*
+ * arena_purge - Drop the physical pages inside every large free block
+ * of ar that has sat unchanged since the last call, and reset its dirty
+ * byte count.
+ *
+ * Only blocks of PURGE_MIN_BLOCK or more are visited. Each moves one
+ * step along its purge state per call: a block changed since the last
+ * call gets IDLE_BIT, an idle one is purged and gets PURGED_BIT, and a
+ * purged one is left alone. So a block freed only to be reused within
+ * the next PURGE_THRESHOLD bytes of frees keeps its pages, and none is
+ * purged twice. In each block the header, the free-list links or tree
+ * node, and the footer stay put; the whole system pages strictly
+ * between them are purged.
+ *
+ * Return: nothing.
+ */
+static void arena_purge(Arena *ar) {
+    uintptr_t page = mem_pagesize();
+
+    for_each_free_block(ar, PURGE_MIN_BLOCK, [&](char *bp) {
+        word_t state = GET_PURGE_BITS(FTRP(bp));
+        if (state & PURGED_BIT) return;
+        if (state & IDLE_BIT) {
+            uintptr_t lo = ((uintptr_t)bp + TREE_NODE_SIZE + page - 1) & ~(page - 1);
+            uintptr_t hi = (uintptr_t)FTRP(bp) & ~(page - 1);
+            if (hi > lo) mem_purge((void *)lo, hi - lo);
+        }
+        PUT(FTRP(bp), GET(FTRP(bp)) | (state ? PURGED_BIT : IDLE_BIT));
+    });
+    ar->dirty_bytes = 0;
+}
+
+/*
+ * find_fit - Return a free block >= asize bytes, or nullptr.
+ *
+ * 1. Probe at most FIT_PROBE_LIMIT blocks of asize's own bin first-fit.
+ *    That bin also holds blocks slightly smaller than asize, but taking
+ *    a block from it avoids splitting a larger one.
+ * 2. Otherwise take the head of the first non-empty bin strictly above
+ *    it, found through the bitmaps; every block there fits.
+ *
+ * Both steps are bounded, so malloc latency does not grow with the
+ * number of free blocks. The profile counts every probed block, plus
+ * the bin head taken in step 2, as visited.
+ *
+ * Tree bins (see bin_is_tree) are searched for a best fit instead: a
+ * lower-bound search in asize's own bin, and if that misses, the
+ * smallest block of the next non-empty bin. Both are O(log n).
+ *
+ * Under the address-ordered policy the bins only hold blocks too small
+ * for a tree node, which are taken first if asize is that small; any
+ * other request gets the lowest-addressed fitting block from the tree.
+ */
+static void *find_fit(Arena *ar, size_t asize) {
+    int   fl, sl;
+    int   visited = 0;
+    void *bp      = nullptr;
+    mapping_insert(asize, &fl, &sl);
+
+    if (fit_policy == FIT_ADDRESS) {
+        if ((bp = find_suitable_bin(ar, fl, sl)) != nullptr) visited = 1;
+        else bp = tree_first_fit(ar->addr_tree, asize, &visited);
+        PROFILE_FIT(ar, visited);
+        return bp;
+    }
+
+    if (bin_is_tree(fl)) {
+        bp = tree_best_fit(ar->free_lists[fl][sl], asize, &visited);
+    } else {
+        for (bp = ar->free_lists[fl][sl];
+             bp != nullptr && visited < FIT_PROBE_LIMIT;
+             bp = harden_link(GET_NEXT_FREE(bp)), ++visited) {
+            if (asize <= GET_SIZE(HDRP(bp))) break;
+        }
+        if (bp != nullptr && visited < FIT_PROBE_LIMIT) ++visited;
+        else                                            bp = nullptr;
+    }
+    if (bp != nullptr) {
+        PROFILE_FIT(ar, visited);
+        return bp;
+    }
+
+    /* Step to the next bin; wrap into the next first-level bin if needed */
+    if (++sl == SL_COUNT) {
+        sl = 0;
+        ++fl;
+    }
+    if (fl < FL_COUNT && (bp = find_suitable_bin(ar, fl, sl)) != nullptr) {
+        /* Everything in a later bin fits; in a tree bin take the smallest */
+        if (fit_policy == FIT_BEST && GET_SIZE(HDRP(bp)) >= BEST_FIT_MIN)
+            bp = tree_leftmost((char*)bp, &visited);
+        else
+            ++visited;
+    }
+    PROFILE_FIT(ar, visited);
+    return bp;
+}
+
+/*
+ * place - Allocate asize bytes at bp, splitting if the remainder is usable.
+ *
+ * Steps:
+ * 1. Read csize = GET_SIZE(HDRP(bp)).
+ * 2. remove_from_free_list(ar, bp).
+ * 3. If (csize - asize) >= MIN_BLOCK_SIZE:
+ *      - Write allocated header (no footer) for first asize bytes.
+ *      - Advance bp to NEXT_BLKP(bp).
+ *      - Write free header+footer for remaining (csize-asize) bytes,
+ *        with the prev-allocated bit set.
+ *      - add_to_free_list(ar, bp) for the leftover.
+ *    Else:
+ *      - Write allocated header using full csize, and set the
+ *        prev-allocated bit of the following block.
+ *    Note: use MIN_BLOCK_SIZE (not 2*DSIZE) as the threshold. On 64-bit systems
+ *    a remainder of only 16 bytes cannot hold the two free-list pointers.
+ *
+ * A known-zero block passes its ZERO_BIT on to the remainder, and its
+ * purge state too: the remainder's interior pages lie inside bp's, past
+ * everything written here.
+ *
+ * Return: true if bp was a known-zero free block, so that its payload
+ *         is zero apart from its first TREE_NODE_SIZE bytes and the last
+ *         word (the old footer).
+ */
+static bool place(Arena *ar, void *bp, size_t asize) {
+    size_t       csize      = GET_SIZE(HDRP(bp));
+    size_t       prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+    word_t       zero       = GET_ZERO(HDRP(bp));
+    word_t       purged     = GET_PURGE_BITS(FTRP(bp));
+    remove_from_free_list(ar, bp);
+    TOUCH(ar, bp);
+
+    if ((csize - asize) >= MIN_BLOCK_SIZE) {
+        PUT(HDRP(bp), PACK(asize, prev_alloc, 1));
+        SEAL(bp);
+        bp = NEXT_BLKP(bp);
+        PUT(HDRP(bp), PACK(csize - asize, 1, 0) | zero);
+        PUT(FTRP(bp), PACK(csize - asize, 0, 0) | purged);
+        add_to_free_list(ar, bp);
+    } else {
+        PUT(HDRP(bp), PACK(csize, prev_alloc, 1));
+        SEAL(bp);
+        SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+    }
+    return zero != 0;
+}
+
+/*
+ * adjust_size - Convert a payload request into a block size.
+ *
+ * Allocated blocks carry only a header (and in hardened mode a seal), so
+ * ALLOC_OVERHEAD is added and the result rounded up to ALIGNMENT, but
+ * never below MIN_BLOCK_SIZE so the block can hold its free-list links
+ * and footer once freed.
+ *
+ * Return: the adjusted block size asize.
+ */
+static size_t adjust_size(size_t size) {
+    if (size <= MIN_BLOCK_SIZE - ALLOC_OVERHEAD) return MIN_BLOCK_SIZE;
+    return ALIGNMENT * ((size + (ALLOC_OVERHEAD) + (ALIGNMENT - 1)) / ALIGNMENT);
+}
+
+/*
+ * resize_in_place - Make the allocated block bp exactly asize bytes
+ * (plus any unsplittable slack) without moving it.
+ *
+ * Three cases:
+ *   1. Shrink: split off the tail as a free block and coalesce it with
+ *      whatever follows.
+ *   2. Grow into a free next block if the two together are big enough.
+ *   3. Grow at the end of the heap: if bp (or bp's free next block) is
+ *      the last block before the epilogue and its region ends at the
+ *      memlib break, extend the region so case 2 applies.
+ *
+ * In deferred-coalescing mode, a next block parked on a quick list is
+ * freed for real first, so growing is not blocked by a dead neighbor.
+ *
+ * Return: true if bp now holds at least asize bytes, false if the
+ *         caller has to move the data.
+ */
+static bool resize_in_place(Arena *ar, void *bp, size_t asize) {
+    size_t csize      = GET_SIZE(HDRP(bp));
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+    TOUCH(ar, bp);
+
+    if (asize <= csize) {                              /* Case 1: shrink */
+        if (csize - asize >= MIN_BLOCK_SIZE) {
+            PUT(HDRP(bp), PACK(asize, prev_alloc, 1));
+            SEAL(bp);
+            char *rest = NEXT_BLKP(bp);
+            PUT(HDRP(rest), PACK(csize - asize, 1, 0));
+            PUT(FTRP(rest), PACK(csize - asize, 0, 0));
+            coalesce(ar, rest);
+        }
+        return true;
+    }
+
+    char  *next  = NEXT_BLKP(bp);
+    size_t avail = csize;
+    if (DEFER_COALESCE && GET_ALLOC(HDRP(next))) quick_release(ar, next);
+    if (!GET_ALLOC(HDRP(next))) avail += GET_SIZE(HDRP(next));
+
+    if (avail < asize) {                               /* Case 3: heap tail */
+        char *last = GET_ALLOC(HDRP(next)) ? next : NEXT_BLKP(next);
+        if (GET_SIZE(HDRP(last)) != 0) return false;   /* Not the epilogue */
+        if (last != ar->region_end) return false;       /* Not the newest region */
+
+        size_t need = asize - avail;
+        if (need < CHUNKSIZE) need = CHUNKSIZE;
+        if (extend_heap(ar, need / WSIZE, true) == nullptr) return false;
+
+        /* extend_heap coalesced the new space with any free next block */
+        next  = NEXT_BLKP(bp);
+        avail = csize + GET_SIZE(HDRP(next));
+    }
+
+    /* Case 2: absorb the free next block, splitting off what is left */
+    remove_from_free_list(ar, next);
+    touch_forget(ar, (char*)bp, avail);
+    if (avail - asize >= MIN_BLOCK_SIZE) {
+        PUT(HDRP(bp), PACK(asize, prev_alloc, 1));
+        SEAL(bp);
+        char *rest = NEXT_BLKP(bp);
+        PUT(HDRP(rest), PACK(avail - asize, 1, 0));
+        PUT(FTRP(rest), PACK(avail - asize, 0, 0));
+        add_to_free_list(ar, rest);
+    } else {
+        PUT(HDRP(bp), PACK(avail, prev_alloc, 1));
+        SEAL(bp);
+        SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+    }
+    return true;
+}
+
+/*
+ * add_to_free_list - Insert bp at the head of its TLSF bin (LIFO), into
+ * the bin's tree if it is a tree bin, or into the arena's address tree
+ * under the address-ordered policy.
+ *
+ * The bin is chosen from the size in bp's header, so the header must
+ * already hold the final size when this is called.
+ *
+ * Return: nothing.
+ */
+static void add_to_free_list(Arena *ar, void *bp) {
+    size_t size = GET_SIZE(HDRP(bp));
+    TOUCH(ar, bp);
+    if (fit_policy == FIT_ADDRESS && size >= TREE_MIN_BLOCK) {
+        ar->addr_tree = tree_insert(ar->addr_tree, (char*)bp);
+        return;
+    }
+
+    int fl, sl;
+    mapping_insert(size, &fl, &sl);
+    char **headp = &ar->free_lists[fl][sl];
+
+    if (bin_is_tree(fl)) {
+        *headp = tree_insert(*headp, (char*)bp);
+    } else {
+        SET_NEXT_FREE(bp, *headp);
+        SET_PREV_FREE(bp, nullptr);
+        if (*headp != nullptr) {
+            SET_PREV_FREE(*headp, bp);
+        }
+        *headp = (char*)bp;
+    }
+
+    ar->fl_bitmap     |= uint64_t(1) << fl;
+    ar->sl_bitmap[fl] |= uint32_t(1) << sl;
+}
+
+/*
+ * remove_from_free_list - Unlink bp from its TLSF bin or free tree.
+ *
+ * The header size must still be the one bp was inserted with; that is
+ * why coalesce() removes neighbors before rewriting any sizes. In
+ * hardened mode a list block's neighbors must link back to it.
+ *
+ * Return: nothing.
+ */
+static void remove_from_free_list(Arena *ar, void *bp) {
+    size_t size = GET_SIZE(HDRP(bp));
+    if (fit_policy == FIT_ADDRESS && size >= TREE_MIN_BLOCK) {
+        ar->addr_tree = tree_remove(ar->addr_tree, (char*)bp);
+        return;
+    }
+
+    int fl, sl;
+    mapping_insert(size, &fl, &sl);
+    if (bin_is_tree(fl)) {
+        ar->free_lists[fl][sl] = tree_remove(ar->free_lists[fl][sl], (char*)bp);
+        if (ar->free_lists[fl][sl] == nullptr) {
+            ar->sl_bitmap[fl] &= ~(uint32_t(1) << sl);
+            if (ar->sl_bitmap[fl] == 0) ar->fl_bitmap &= ~(uint64_t(1) << fl);
+        }
+        return;
+    }
+
+    void *prev = harden_link(GET_PREV_FREE(bp));
+    void *next = harden_link(GET_NEXT_FREE(bp));
+    if (HARDEN && ((prev == nullptr ? ar->free_lists[fl][sl] != bp : GET_NEXT_FREE(prev) != bp) ||
+                   (next != nullptr && GET_PREV_FREE(next) != bp)))
+        harden_fail("corrupted free list", bp);
+
+    if (prev == nullptr) {
+        ar->free_lists[fl][sl] = (char*)next;
+        if (next == nullptr) {
+            /* Bin became empty: clear its bit, and the level-1 bit if it
+             * was the last non-empty bin in this first-level range */
+            ar->sl_bitmap[fl] &= ~(uint32_t(1) << sl);
+            if (ar->sl_bitmap[fl] == 0) ar->fl_bitmap &= ~(uint64_t(1) << fl);
+        }
+    } else {
+        SET_NEXT_FREE(prev, next);
+    }
+
+    if (next != nullptr) {
+        SET_PREV_FREE(next, prev);
+    }
+}
+
+/*
+ * mapping_insert - Compute the TLSF bin (fl, sl) that holds a block of
+ * the given size.
+ *
+ * Return: nothing; results through fl and sl.
+ */
+static void mapping_insert(size_t size, int *fl, int *sl) {
+    if (size < SMALL_BLOCK_SIZE) {
+        *fl = 0;
+        *sl = static_cast<int>(size / (SMALL_BLOCK_SIZE / SL_COUNT));
+    } else {
+        int msb = 63 - __builtin_clzll(size);
+        *fl = msb - FL_SHIFT + 1;
+        *sl = static_cast<int>((size >> (msb - SL_LOG2)) - SL_COUNT);
+    }
+}
+
+/*
+ * find_suitable_bin - Return the head of the first non-empty bin at or
+ * after (fl, sl) in size order, or nullptr if there is none.
+ *
+ * Uses the occupancy bitmaps: one ctz on the second-level word of fl,
+ * and if that range is empty, one ctz on ar->fl_bitmap above fl.
+ */
+static void *find_suitable_bin(Arena *ar, int fl, int sl) {
+    uint32_t sl_map = ar->sl_bitmap[fl] & (~uint32_t(0) << sl);
+
+    if (sl_map == 0) {
+        uint64_t fl_map = (fl + 1 < 64) ? ar->fl_bitmap & (~uint64_t(0) << (fl + 1)) : 0;
+        if (fl_map == 0) return nullptr;
+        fl     = __builtin_ctzll(fl_map);
+        sl_map = ar->sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+    return ar->free_lists[fl][sl];
+}
+
+/* ============================================
+ * Free tree
+ *
+ * A treap: a binary search tree on block keys that is also a heap on a
+ * priority hashed from each address. Hashed priorities behave like
+ * random ones, so the expected depth is O(log n) whatever the order of
+ * frees, and no balance field needs storing. Every operation works down
+ * from the root, so nodes carry no parent pointer either.
+ *
+ * The key is (size, address) under the best-fit policy and the address
+ * alone under the address-ordered one (see tree_before). Either way all
+ * keys are distinct.
+ * ============================================ */
+
+/*
+ * tree_before - Tell whether block a sorts before block b in the tree.
+ *
+ * Return: true if a's key is the smaller.
+ */
+static bool tree_before(const char *a, const char *b) {
+    if (fit_policy == FIT_BEST) {
+        size_t sa = GET_SIZE(HDRP(a)), sb = GET_SIZE(HDRP(b));
+        if (sa != sb) return sa < sb;
+    }
+    return a < b;
+}
+
+/*
+ * tree_priority - Heap priority of the node at bp (a 64-bit mix of its
+ * address).
+ *
+ * Return: the priority; parents' are never lower than their children's.
+ */
+static uint64_t tree_priority(const char *bp) {
+    uint64_t x = (uintptr_t)bp;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/*
+ * tree_update - Recompute TREE_MAX of t from its own size and its
+ * children's TREE_MAX.
+ *
+ * Return: nothing.
+ */
+static void tree_update(char *t) {
+    word_t max = GET_SIZE(HDRP(t));
+    if (TREE_LEFT(t)  != nullptr && TREE_MAX(TREE_LEFT(t))  > max) max = TREE_MAX(TREE_LEFT(t));
+    if (TREE_RIGHT(t) != nullptr && TREE_MAX(TREE_RIGHT(t)) > max) max = TREE_MAX(TREE_RIGHT(t));
+    TREE_MAX(t) = max;
+}
+
+/*
+ * tree_split - Split tree t into the nodes that sort before key and
+ * those that sort after it.
+ *
+ * Return: nothing; the two trees through left and right.
+ */
+static void tree_split(char *t, char *key, char **left, char **right) {
+    if (t == nullptr) {
+        *left = *right = nullptr;
+    } else if (tree_before(t, key)) {
+        tree_split(TREE_RIGHT(t), key, &TREE_RIGHT(t), right);
+        tree_update(t);
+        *left = t;
+    } else {
+        tree_split(TREE_LEFT(t), key, left, &TREE_LEFT(t));
+        tree_update(t);
+        *right = t;
+    }
+}
+
+/*
+ * tree_merge - Join two trees, every node of left lying below every
+ * node of right.
+ *
+ * Return: the root of the joined tree.
+ */
+static char *tree_merge(char *left, char *right) {
+    if (left == nullptr)  return right;
+    if (right == nullptr) return left;
+
+    if (tree_priority(left) > tree_priority(right)) {
+        TREE_RIGHT(left) = tree_merge(TREE_RIGHT(left), right);
+        tree_update(left);
+        return left;
+    }
+    TREE_LEFT(right) = tree_merge(left, TREE_LEFT(right));
+    tree_update(right);
+    return right;
+}
+
+/*
+ * tree_insert - Add the free block bp to tree t. bp's header must hold
+ * its final size.
+ *
+ * Walks down to where bp's priority belongs and splits the subtree
+ * there around bp.
+ *
+ * Return: the new root.
+ */
+static char *tree_insert(char *t, char *bp) {
+    if (t == nullptr || tree_priority(bp) > tree_priority(t)) {
+        tree_split(t, bp, &TREE_LEFT(bp), &TREE_RIGHT(bp));
+        tree_update(bp);
+        return bp;
+    }
+    if (tree_before(bp, t)) TREE_LEFT(t)  = tree_insert(TREE_LEFT(t), bp);
+    else                    TREE_RIGHT(t) = tree_insert(TREE_RIGHT(t), bp);
+    tree_update(t);
+    return t;
+}
+
+/*
+ * tree_remove - Take bp, which must be in tree t, out of it by merging
+ * its two subtrees in its place.
+ *
+ * Return: the new root.
+ */
+static char *tree_remove(char *t, char *bp) {
+    if (t == bp) return tree_merge(harden_link(TREE_LEFT(t)), harden_link(TREE_RIGHT(t)));
+
+    if (tree_before(bp, t)) TREE_LEFT(t)  = tree_remove(TREE_LEFT(t), bp);
+    else                    TREE_RIGHT(t) = tree_remove(TREE_RIGHT(t), bp);
+    tree_update(t);
+    return t;
+}
+
+/*
+ * tree_first_fit - Find the lowest-addressed block of at least asize
+ * bytes in the address-keyed tree t, adding the number of nodes looked
+ * at to *visited.
+ *
+ * At each node: if the left subtree holds a fit, the answer is there;
+ * else the node itself, if it fits; else the right subtree, which then
+ * must hold one. TREE_MAX answers the first question without a search.
+ *
+ * Return: the block, or nullptr if none is big enough.
+ */
+static char *tree_first_fit(char *t, size_t asize, int *visited) {
+    while (t != nullptr && TREE_MAX(t) >= asize) {
+        ++*visited;
+        if (TREE_LEFT(t) != nullptr && TREE_MAX(TREE_LEFT(t)) >= asize) t = TREE_LEFT(t);
+        else if (GET_SIZE(HDRP(t)) >= asize)                            return t;
+        else                                                            t = TREE_RIGHT(t);
+    }
+    return nullptr;
+}
+
+/*
+ * tree_best_fit - Find the smallest block of at least asize bytes in the
+ * (size, address)-keyed tree t, the lowest-addressed one on a tie,
+ * adding the number of nodes looked at to *visited.
+ *
+ * A lower-bound search: every node that fits is a candidate and sends
+ * the search left for a smaller one; one that does not sends it right.
+ *
+ * Return: the block, or nullptr if none is big enough.
+ */
+static char *tree_best_fit(char *t, size_t asize, int *visited) {
+    char *fit = nullptr;
+    while (t != nullptr) {
+        ++*visited;
+        if (GET_SIZE(HDRP(t)) >= asize) {
+            fit = t;
+            t   = TREE_LEFT(t);
+        } else {
+            t   = TREE_RIGHT(t);
+        }
+    }
+    return fit;
+}
+
+/*
+ * tree_leftmost - Find the block with the smallest key in tree t, adding
+ * the number of nodes looked at to *visited.
+ *
+ * Return: the block; t must not be empty.
+ */
+static char *tree_leftmost(char *t, int *visited) {
+    ++*visited;
+    while (TREE_LEFT(t) != nullptr) {
+        t = TREE_LEFT(t);
+        ++*visited;
+    }
+    return t;
+}
+
+/*
+ * tree_walk - Call fn on every block of at least min_size bytes in tree
+ * t, in key order, skipping subtrees whose TREE_MAX is too small.
+ *
+ * Return: nothing.
+ */
+template <typename F>
+static void tree_walk(char *t, size_t min_size, F &fn) {
+    if (t == nullptr || TREE_MAX(t) < min_size) return;
+    tree_walk(TREE_LEFT(t), min_size, fn);
+    if (GET_SIZE(HDRP(t)) >= min_size) fn(t);
+    tree_walk(TREE_RIGHT(t), min_size, fn);
+}
+
+/*
+ * for_each_free_block - Call fn on every free block of ar of at least
+ * min_size bytes: the bins that can hold one, then the address tree.
+ *
+ * fn must not add or remove free blocks. Caller holds ar->lock.
+ *
+ * Return: nothing.
+ */
+template <typename F>
+static void for_each_free_block(Arena *ar, size_t min_size, F fn) {
+    int fl, sl;
+    mapping_insert(min_size, &fl, &sl);
+
+    uint64_t fl_map = ar->fl_bitmap & (~uint64_t(0) << fl);
+    while (fl_map != 0) {
+        fl = __builtin_ctzll(fl_map);
+        fl_map &= fl_map - 1;
+
+        for (sl = 0; sl < SL_COUNT; ++sl) {
+            if (bin_is_tree(fl)) {
+                tree_walk(ar->free_lists[fl][sl], min_size, fn);
+                continue;
+            }
+            for (char *bp = ar->free_lists[fl][sl]; bp != nullptr; bp = (char*)GET_NEXT_FREE(bp)) {
+                if (GET_SIZE(HDRP(bp)) >= min_size) fn(bp);
+            }
+        }
+    }
+    tree_walk(ar->addr_tree, min_size, fn);
+}
+
+/*
+ * quick_push - Park an allocated block of the given size on its quick list.
+ *
+ * The block keeps its allocated bit, so coalesce() never merges into it
+ * and no prev-allocated bits change.
+ *
+ * Return: true if parked, false if the block's size has no quick list
+ *         or its list is full (the caller must then free it normally).
+ */
+static bool quick_push(Arena *ar, void *bp, size_t size) {
+    if (size < QUICK_MIN_SIZE || size > QUICK_MAX_SIZE) return false;
+
+    int idx = static_cast<int>((size - QUICK_MIN_SIZE) / ALIGNMENT);
+    if (ar->quick_counts[idx] >= QUICK_LIST_MAX) return false;
+
+    SET_NEXT_FREE(bp, ar->quick_lists[idx]);
+    harden_park(bp);
+    ar->quick_lists[idx] = (char*)bp;
+    ++ar->quick_counts[idx];
+    TOUCH(ar, bp);
+    return true;
+}
+
+/*
+ * quick_pop - Take a parked block of exactly asize bytes.
+ *
+ * Return: the block (still marked allocated), or nullptr if none.
+ */
+static void *quick_pop(Arena *ar, size_t asize) {
+    if (asize < QUICK_MIN_SIZE || asize > QUICK_MAX_SIZE) return nullptr;
+
+    int idx = static_cast<int>((asize - QUICK_MIN_SIZE) / ALIGNMENT);
+    char *bp = ar->quick_lists[idx];
+    if (bp != nullptr) {
+        ar->quick_lists[idx] = harden_link(GET_NEXT_FREE(bp));
+        --ar->quick_counts[idx];
+        if (HARDEN) SET_PREV_FREE(bp, nullptr);     /* No longer parked */
+        TOUCH(ar, bp);
+    }
+    return bp;
+}
+
+/*
+ * quick_release - If the allocated block bp is parked on a quick list,
+ * take it off and free it for real, merging it with free neighbors.
+ * Walks at most one list of QUICK_LIST_MAX blocks.
+ *
+ * Return: nothing.
+ */
+static void quick_release(Arena *ar, void *bp) {
+    size_t size = GET_SIZE(HDRP(bp));
+    if (size < QUICK_MIN_SIZE || size > QUICK_MAX_SIZE) return;
+
+    int    idx  = static_cast<int>((size - QUICK_MIN_SIZE) / ALIGNMENT);
+    char **link = &ar->quick_lists[idx];
+    while (*link != nullptr && *link != bp) link = (char **)harden_link(*link);
+    if (*link == nullptr) return;                   /* Live, or in a tcache */
+
+    *link = harden_link((char*)GET_NEXT_FREE(bp));
+    --ar->quick_counts[idx];
+    if (HARDEN) SET_PREV_FREE(bp, nullptr);         /* No longer parked */
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)), 0));
+    PUT(FTRP(bp), PACK(size, 0, 0));
+    coalesce(ar, bp);
+}
+
+/*
+ * flush_quick_lists - Free and coalesce every parked block.
+ *
+ * Return: true if any block was released (so find_fit is worth retrying).
+ */
+static bool flush_quick_lists(Arena *ar) {
+    bool released = false;
+
+    for (int idx = 0; idx < QUICK_COUNT; ++idx) {
+        char *bp = ar->quick_lists[idx];
+        while (bp != nullptr) {
+            char  *next = harden_link(GET_NEXT_FREE(bp));
+            size_t size = GET_SIZE(HDRP(bp));
+            if (HARDEN) SET_PREV_FREE(bp, nullptr);     /* No longer parked */
+            PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)), 0));
+            PUT(FTRP(bp), PACK(size, 0, 0));
+            coalesce(ar, bp);
+            bp = next;
+            released = true;
+        }
+        ar->quick_lists[idx]  = nullptr;
+        ar->quick_counts[idx] = 0;
+    }
+    return released;
+}
+
+/*
+ * remote_free_push - Hand an allocated block of arena ar, freed by a
+ * thread bound to another arena, to ar without taking its lock.
+ *
+ * A Treiber-stack push: the block's first payload word links to the old
+ * head, and a CAS publishes the block as the new head. Any number of
+ * threads may push concurrently.
+ *
+ * Return: nothing.
+ */
+static void remote_free_push(Arena *ar, void *bp) {
+    char *head = ar->remote_frees.load(std::memory_order_relaxed);
+    harden_park(bp);
+    do {
+        SET_NEXT_FREE(bp, head);
+    } while (!ar->remote_frees.compare_exchange_weak(head, (char*)bp,
+                                                      std::memory_order_release,
+                                                      std::memory_order_relaxed));
+}
+
+/*
+ * remote_free_drain - Free every block on ar's remote-free stack.
+ *
+ * Caller holds ar->lock, which makes it the stack's only consumer. The
+ * whole stack is detached with one exchange, so there is no ABA hazard
+ * and pushers are never blocked while the blocks are coalesced.
+ *
+ * Return: nothing.
+ */
+static void remote_free_drain(Arena *ar) {
+    char *bp = ar->remote_frees.exchange(nullptr, std::memory_order_acquire);
+    while (bp != nullptr) {
+        char *next = harden_link(GET_NEXT_FREE(bp));
+        free_locked(ar, bp);
+        bp = next;
+    }
+}
+
+/*
+ * wants_mapping - Tell whether a request of size bytes gets a mapping of
+ * its own: it reaches mmap_threshold, or no region could hold it.
+ *
+ * Return: true if mmap_malloc should serve it.
+ */
+static bool wants_mapping(size_t size) {
+    return size >= mmap_threshold || size > HEAP_REQUEST_MAX;
+}
+
+/*
+ * is_mmapped - Tell whether bp is a mapped block rather than a pointer
+ * into memlib's heap. Mappings never overlap the heap's address range.
+ *
+ * Return: true if bp lies outside the heap.
+ */
+static bool is_mmapped(const void *bp) {
+    return (uintptr_t)bp - (uintptr_t)heap_base >= mem_maxheap();
+}
+
+/*
+ * mmap_malloc - Give a request of size bytes a mapping of its own.
+ *
+ * Return: pointer to the payload, or nullptr if the mapping fails.
+ */
+static void *mmap_malloc(size_t size) {
+    size_t page = mem_pagesize();
+    if (size > SIZE_MAX - MMAP_OVERHEAD - page) return nullptr;
+    size_t len  = (size + MMAP_OVERHEAD + page - 1) & ~(page - 1);
+
+    char *map = (char*)mem_map(len);
+    if ((long)map == -1) return nullptr;
+
+    char *bp = map + MMAP_OVERHEAD;
+    MMAP_LEN(bp) = len;
+    if (HARDEN) MMAP_SEAL(bp) = mmap_seal(bp, len);
+    mapped_bytes.fetch_add(len, std::memory_order_relaxed);
+    return bp;
+}
+
+/*
+ * mmap_realloc - Resize the mapped block bp to hold size bytes.
+ *
+ * mem_remap grows or shrinks the mapping in place when it can and
+ * otherwise moves its pages, so the payload is never copied.
+ *
+ * Return: the possibly moved payload, or nullptr (bp untouched) on failure.
+ */
+static void *mmap_realloc(void *bp, size_t size) {
+    size_t page = mem_pagesize();
+    if (size > SIZE_MAX - MMAP_OVERHEAD - page) return nullptr;
+    size_t len  = (size + MMAP_OVERHEAD + page - 1) & ~(page - 1);
+    size_t old  = MMAP_LEN(bp);
+    if (len == old) return bp;
+
+    char *map = (char*)mem_remap((char*)bp - MMAP_OVERHEAD, old, len);
+    if ((long)map == -1) return nullptr;
+
+    bp = map + MMAP_OVERHEAD;
+    MMAP_LEN(bp) = len;
+    if (HARDEN) MMAP_SEAL(bp) = mmap_seal(bp, len);
+    mapped_bytes.fetch_add(len - old, std::memory_order_relaxed);   /* Wraps to a subtraction */
+    return bp;
+}
+
+/*
+ * mmap_free - Return the mapping of bp to the OS.
+ *
+ * Return: nothing.
+ */
+static void mmap_free(void *bp) {
+    if (HARDEN) MMAP_SEAL(bp) = 0;                   /* In case the pages are mapped again */
+    mapped_bytes.fetch_sub(MMAP_LEN(bp), std::memory_order_relaxed);
+    mem_unmap((char*)bp - MMAP_OVERHEAD, MMAP_LEN(bp));
+}
+
+/*
+ * slab_class - Map a request of 1..SLAB_MAX_SIZE bytes to the smallest
+ * size class that holds it.
+ *
+ * Return: index into SLAB_SIZES.
+ */
+static int slab_class(size_t size) {
+    if (size <= 128) return static_cast<int>((size + 15) / 16) - 1;
+    return 8 + static_cast<int>((size - 129) / 32);
+}
+
+/*
+ * slab_run_of - Find the descriptor of the run holding slab slot bp.
+ *
+ * Runs are single pages laid out on heap_base's page grid, and the
+ * descriptor sits at the start of the page.
+ *
+ * Return: the run's descriptor.
+ */
+static SlabRun *slab_run_of(const void *bp) {
+    size_t offset = static_cast<size_t>((const char*)bp - heap_base);
+    return reinterpret_cast<SlabRun *>(heap_base + (offset & ~(CHUNKSIZE - 1)));
+}
+
+/*
+ * slab_new_run - Take a fresh page from memlib for a slab run of ar and
+ * tag it in the page map.
+ *
+ * Return: the uninitialized run, or nullptr if the heap is exhausted.
+ */
+static SlabRun *slab_new_run(Arena *ar) {
+    std::lock_guard<std::mutex> guard(sbrk_lock);
+
+    char *page = (char*)mem_sbrk(static_cast<int>(CHUNKSIZE));
+    if ((long)page == -1) return nullptr;
+
+    page_owner[(page - heap_base) >> PAGE_SHIFT] =
+        static_cast<uint8_t>((ar - arenas) + 1) | PAGE_SLAB;
+    return reinterpret_cast<SlabRun *>(page);
+}
+
+/*
+ * slab_run_init - Turn run into an all-free, unlinked run of class cls.
+ *
+ * Return: nothing.
+ */
+static void slab_run_init(SlabRun *run, int cls) {
+    size_t nslots = (CHUNKSIZE - SLAB_HDR_SIZE) / SLAB_SIZES[cls];
+
+    run->next   = nullptr;
+    run->prev   = nullptr;
+    run->cls    = static_cast<uint16_t>(cls);
+    run->nslots = static_cast<uint16_t>(nslots);
+    run->nfree  = static_cast<uint16_t>(nslots);
+
+    memset(run->free_map, 0, sizeof(run->free_map));
+    for (size_t w = 0; w < nslots / 64; ++w) run->free_map[w] = ~uint64_t(0);
+    if (nslots % 64 != 0) run->free_map[nslots / 64] = (uint64_t(1) << (nslots % 64)) - 1;
+}
+
+/*
+ * slab_malloc_locked - Take one slot of class cls from arena ar.
+ *
+ * Caller holds ar->lock.
+ *
+ * Steps:
+ * 1. Drain remote frees, as malloc_locked does.
+ * 2. Use the first partial run of the class; if there is none, take over
+ *    an empty run, or a new page if the arena has no empty run either.
+ * 3. Claim the lowest free slot: the first non-zero free_map word, then
+ *    ctz within it. A run with no free slot left leaves the partial list.
+ *
+ * Return: pointer to the slot, or nullptr if the heap is exhausted.
+ */
+static void *slab_malloc_locked(Arena *ar, int cls) {
+    if (ar->remote_frees.load(std::memory_order_relaxed) != nullptr) {
+        remote_free_drain(ar);
+    }
+
+    SlabRun *run = ar->slab_partial[cls];
+    if (run == nullptr) {
+        if ((run = ar->slab_empty) != nullptr) {
+            ar->slab_empty = run->next;
+        } else if ((run = slab_new_run(ar)) == nullptr) {
+            return nullptr;
+        }
+        slab_run_init(run, cls);
+        ar->slab_partial[cls] = run;
+    }
+
+    int w = 0;
+    while (run->free_map[w] == 0) ++w;
+    size_t slot = 64 * w + __builtin_ctzll(run->free_map[w]);
+    run->free_map[w] &= run->free_map[w] - 1;
+
+    if (--run->nfree == 0) {
+        ar->slab_partial[cls] = run->next;
+        if (run->next != nullptr) run->next->prev = nullptr;
+    }
+    TOUCH(ar, run);
+    return (char*)run + SLAB_HDR_SIZE + slot * SLAB_SIZES[cls];
+}
+
+/*
+ * slab_free_locked - Return slab slot bp to its run in arena ar.
+ *
+ * Caller holds ar->lock.
+ *
+ * A run that was full rejoins the partial list of its class. A run that
+ * becomes wholly free moves to the arena's empty list, where any class
+ * can reuse it, unless it is the only partial run of its class: keeping
+ * that one avoids re-initializing a run on every alloc/free pair.
+ *
+ * Return: nothing.
+ */
+static void slab_free_locked(Arena *ar, void *bp) {
+    SlabRun *run  = slab_run_of(bp);
+    int      cls  = run->cls;
+    size_t   slot = static_cast<size_t>((char*)bp - ((char*)run + SLAB_HDR_SIZE)) / SLAB_SIZES[cls];
+
+    if (HARDEN && (run->free_map[slot / 64] >> (slot % 64)) & 1) harden_fail("double free", bp);
+    run->free_map[slot / 64] |= uint64_t(1) << (slot % 64);
+    TOUCH(ar, run);
+
+    if (++run->nfree == 1) {                      /* Was full */
+        run->prev = nullptr;
+        run->next = ar->slab_partial[cls];
+        if (run->next != nullptr) run->next->prev = run;
+        ar->slab_partial[cls] = run;
+    } else if (run->nfree == run->nslots &&
+               (run->prev != nullptr || run->next != nullptr)) {
+        if (run->prev != nullptr) run->prev->next = run->next;
+        else                      ar->slab_partial[cls] = run->next;
+        if (run->next != nullptr) run->next->prev = run->prev;
+        run->next      = ar->slab_empty;
+        ar->slab_empty = run;
+    }
+}
+
+/*
+ * tcache_ready - Return the calling thread's cache, resetting it if it
+ * was filled against an older heap (or never used). A reset also binds
+ * the thread to the next arena in round-robin order.
+ *
+ * The first reset in each thread also registers the cache with the
+ * thread-exit hook so its blocks are returned when the thread ends, and
+ * adds it to stats_threads.
+ * The main thread's cache is never flushed at exit: by then the test
+ * harness has usually torn the heap down with mem_deinit().
+ *
+ * Return: the calling thread's cache.
+ */
+static ThreadCache *tcache_ready(void) {
+    ThreadCache *tc  = &tcache;
+    unsigned     gen = heap_generation.load(std::memory_order_acquire);
+
+    if (tc->generation != gen) {
+        if (tc->generation == 0) {
+            pthread_setspecific(tcache_key, tc);
+            std::lock_guard<std::mutex> guard(stats_lock);
+            tc->stats_next = stats_threads;
+            if (stats_threads != nullptr) stats_threads->stats_prev = tc;
+            stats_threads = tc;
+        }
+        memset(tc->bins, 0, sizeof(tc->bins));
+        memset(tc->counts, 0, sizeof(tc->counts));
+        tc->arena      = &arenas[next_arena.fetch_add(1, std::memory_order_relaxed) % narenas];
+        tc->generation = gen;
+    }
+    return tc;
+}
+
+/*
+ * tcache_refill - Allocate TCACHE_FILL slots or blocks for bin idx from
+ * the thread's arena under one lock; return one and cache the rest.
+ *
+ * Return: an allocated slot or block, or nullptr if the heap is exhausted.
+ */
+static void *tcache_refill(ThreadCache *tc, int idx) {
+    Arena *ar    = tc->arena;
+    size_t asize = TCACHE_MIN_SIZE + (idx - SLAB_COUNT) * ALIGNMENT;  /* Heap bins only */
+    char  *bp;
+
+    auto take = [&]() -> char * {
+        return (char*)(idx < SLAB_COUNT ? slab_malloc_locked(ar, idx) : malloc_locked(ar, asize, nullptr));
+    };
+
+    std::lock_guard<std::mutex> guard(ar->lock);
+    if ((bp = take()) == nullptr) return nullptr;
+
+    for (int i = 1; i < TCACHE_FILL && tc->counts[idx] < TCACHE_BIN_MAX; ++i) {
+        char *extra = take();
+        if (extra == nullptr) break;
+        SET_NEXT_FREE(extra, tc->bins[idx]);
+        harden_park(extra);
+        tc->bins[idx] = extra;
+        ++tc->counts[idx];
+    }
+    return bp;
+}
+
+/*
+ * tcache_spill - Return all but keep blocks of bin idx to their owning
+ * arenas.
+ *
+ * Blocks of the thread's own arena are freed under a single acquisition
+ * of its lock, taken only if there is at least one; blocks of other
+ * arenas go onto their remote-free stacks without locking.
+ *
+ * Return: nothing.
+ */
+static void tcache_spill(ThreadCache *tc, int idx, int keep) {
+    Arena *own    = tc->arena;
+    bool   locked = false;
+
+    while (tc->counts[idx] > keep) {
+        char *bp = tc->bins[idx];
+        tc->bins[idx] = harden_link(GET_NEXT_FREE(bp));
+        --tc->counts[idx];
+
+        Arena *ar = arena_of(bp);
+        if (ar != own) {
+            remote_free_push(ar, bp);
+            continue;
+        }
+        if (!locked) {
+            own->lock.lock();
+            locked = true;
+        }
+        free_locked(own, bp);
+    }
+    if (locked) own->lock.unlock();
+}
+
+/*
+ * tcache_thread_exit - pthread key destructor: fold an exiting thread's
+ * statistics into the retired totals, and give its cached blocks back
+ * to their arenas unless they belong to a heap that has since been
+ * reinitialized.
+ *
+ * Return: nothing.
+ */
+static void tcache_thread_exit(void *arg) {
+    ThreadCache *tc = static_cast<ThreadCache *>(arg);
+
+    {
+        std::lock_guard<std::mutex> guard(stats_lock);
+        for (int c = 0; c < MM_STATS_CLASSES; ++c) {
+            retired_mallocs[c] += tc->mallocs[c];
+            retired_frees[c]   += tc->frees[c];
+        }
+#if MM_PROFILE
+        for (int k = 0; k < LAT_KINDS; ++k) {
+            for (int b = 0; b < LAT_BUCKETS; ++b) retired_lat[k][b] += tc->lat_hist[k][b];
+        }
+#endif
+        if (tc->stats_prev != nullptr) tc->stats_prev->stats_next = tc->stats_next;
+        else                           stats_threads = tc->stats_next;
+        if (tc->stats_next != nullptr) tc->stats_next->stats_prev = tc->stats_prev;
+    }
+
+    if (tc->generation != heap_generation.load(std::memory_order_acquire)) return;
+
+    for (int idx = 0; idx < TCACHE_COUNT; ++idx) {
+        if (tc->counts[idx] > 0) tcache_spill(tc, idx, 0);
+    }
+}
+
+/*
+ * stats_class - Map a usable block size to its statistics class.
+ *
+ * Return: index into the mm_stats per-class arrays.
+ */
+static int stats_class(size_t usable) {
+    if (usable <= SLAB_MAX_SIZE) return slab_class(usable);
+
+    int cls = SLAB_COUNT + (64 - __builtin_clzll(usable - 1)) - STATS_LOG2_BASE;
+    return cls < MM_STATS_CLASSES ? cls : MM_STATS_CLASSES - 1;
+}
+
+/*
+ * stats_resize - Record that a block was resized in place from
+ * old_usable to new_usable bytes: a free in the old class and a malloc
+ * in the new one, if the two differ.
+ *
+ * Return: nothing.
+ */
+static void stats_resize(size_t old_usable, size_t new_usable) {
+    int from = stats_class(old_usable);
+    int to   = stats_class(new_usable);
+    if (from == to) return;
+
+    ThreadCache *tc = tcache_ready();
+    STAT_INC(tc->frees[from]);
+    STAT_INC(tc->mallocs[to]);
+}
+
+#if MM_PROFILE
+/*
+ * cycle_count - Read the CPU's cycle counter (the time-stamp counter on
+ * x86; elsewhere the virtual counter on AArch64, or nanoseconds).
+ *
+ * Return: the current tick count.
+ */
+static uint64_t cycle_count(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000u + uint64_t(ts.tv_nsec);
+#endif
+}
+
+/*
+ * lat_bucket - Map a tick count to its latency histogram bucket, in the
+ * same two-level way mapping_insert maps block sizes to bins.
+ *
+ * Return: bucket index in [0, LAT_BUCKETS).
+ */
+static int lat_bucket(uint64_t ticks) {
+    if (ticks < LAT_SUB_COUNT) return static_cast<int>(ticks);
+
+    int msb = 63 - __builtin_clzll(ticks);
+    return (msb - LAT_SUB_LOG2 + 1) * LAT_SUB_COUNT +
+           static_cast<int>((ticks >> (msb - LAT_SUB_LOG2)) & (LAT_SUB_COUNT - 1));
+}
+
+/*
+ * lat_bucket_max - Inverse of lat_bucket.
+ *
+ * Return: the largest tick count that falls in bucket.
+ */
+static uint64_t lat_bucket_max(int bucket) {
+    if (bucket < LAT_SUB_COUNT) return static_cast<uint64_t>(bucket);
+
+    int      shift = bucket / LAT_SUB_COUNT - 1;
+    uint64_t lo    = uint64_t(LAT_SUB_COUNT + bucket % LAT_SUB_COUNT) << shift;
+    return lo + (uint64_t(1) << shift) - 1;
+}
+
+/*
+ * profile_percentile - Find the q-quantile of a histogram of n buckets
+ * holding total samples.
+ *
+ * Return: the first bucket at which the running count reaches q * total,
+ *         or 0 for an empty histogram.
+ */
+static int profile_percentile(const unsigned long *hist, int n, unsigned long total, double q) {
+    double        want = q * static_cast<double>(total);
+    unsigned long seen = 0;
+
+    for (int b = 0; b < n; ++b) {
+        seen += hist[b];
+        if (seen > 0 && static_cast<double>(seen) >= want) return b;
+    }
+    return 0;
+}
+#endif
+
+/* ============================================
+ * Hardened mode
+ * ============================================ */
+
+/*
+ * block_seal - Keyed checksum of an allocated heap block's address and
+ * size: a 64-bit multiply-xorshift mix, folded to the 32-bit word it is
+ * stored in.
+ *
+ * Return: the seal.
+ */
+static uint32_t block_seal(const void *bp, size_t size) {
+    uint64_t h = ((uintptr_t)bp ^ harden_key) + size;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    return static_cast<uint32_t>(h ^ (h >> 29));
+}
+
+/*
+ * mmap_seal - Keyed checksum of a mapped block's address and mapping
+ * length, kept whole in the mapping's padding word.
+ *
+ * Return: the seal.
+ */
+static uint64_t mmap_seal(const void *bp, size_t len) {
+    uint64_t h = ((uintptr_t)bp + len) ^ harden_key;
+    h *= 0xff51afd7ed558ccdULL;
+    return h ^ (h >> 31);
+}
+
+/*
+ * harden_fail - Report heap misuse or corruption detected at bp and
+ * abort: once it is found, no allocator state can be trusted.
+ *
+ * Return: never.
+ */
+static void harden_fail(const char *what, const void *bp) {
+    fprintf(stderr, "mm: %s at %p\n", what, bp);
+    abort();
+}
+
+/*
+ * harden_link - Vet a free-list link before it is followed: in hardened
+ * mode it must be null, or ALIGNMENT-aligned and inside the heap.
+ *
+ * Return: link, as a char pointer.
+ */
+static char *harden_link(void *link) {
+    if (HARDEN && link != nullptr &&
+        ((uintptr_t)link % ALIGNMENT != 0 || is_mmapped(link)))
+        harden_fail("corrupted free-list link", link);
+    return (char*)link;
+}
+
+/*
+ * harden_park - Mark a block or slot, whose first word already links
+ * it into a tcache bin, quick list or remote-free stack, as parked there.
+ * Nothing outside hardened mode.
+ *
+ * Return: nothing.
+ */
+static void harden_park(void *bp) {
+    if (HARDEN) SET_PREV_FREE(bp, (void*)harden_key);
+}
+
+/*
+ * harden_check - Abort unless ptr is a live block that mm_malloc handed
+ * out and that may be freed or reallocated.
+ *
+ * Reads are ordered so that each one is known to land in mapped memory:
+ * a mapping's page offset before its seal, the page map before a slot's
+ * run or a block's header, a block's size before its seal. The
+ * parked-block marker is read last, once ptr is known to be a block.
+ *
+ * Return: nothing.
+ */
+static void harden_check(void *ptr) {
+    char *bp = (char*)ptr;
+
+    if (is_mmapped(bp)) {
+        if (((uintptr_t)bp & (mem_pagesize() - 1)) != MMAP_OVERHEAD ||
+            MMAP_SEAL(bp) != mmap_seal(bp, MMAP_LEN(bp)))
+            harden_fail("invalid free: not a block from mm_malloc", bp);
+        return;
+    }
+
+    size_t offset = static_cast<size_t>(bp - heap_base);
+    if (offset % ALIGNMENT != 0 || page_owner[offset >> PAGE_SHIFT] == 0)
+        harden_fail("invalid free: not a block from mm_malloc", bp);
+
+    if (is_slab(bp)) {
+        SlabRun *run  = slab_run_of(bp);
+        char    *slot = (char*)run + SLAB_HDR_SIZE;
+        if (bp < slot || (size_t)(bp - slot) % SLAB_SIZES[run->cls] != 0 ||
+            (size_t)(bp - slot) / SLAB_SIZES[run->cls] >= run->nslots)
+            harden_fail("invalid free: not a slab slot boundary", bp);
+    } else {
+        word_t       hdr  = __atomic_load_n((word_t *)HDRP(bp), __ATOMIC_RELAXED);
+        size_t       size = hdr & ~0x7;
+        if (!(hdr & 0x1) || size < MIN_BLOCK_SIZE || size % ALIGNMENT != 0 ||
+            offset + size > mem_maxheap() || page_owner[(offset + size - 1) >> PAGE_SHIFT] == 0)
+            harden_fail("invalid or double free: not an allocated block", bp);
+        if (GET(bp + size - DSIZE) != block_seal(bp, size))
+            harden_fail("heap overflow: allocated block's seal is broken", bp);
+    }
+    if (GET_PREV_FREE(bp) == (void*)harden_key)
+        harden_fail("double free", bp);
+}
+
+/* ============================================
+ * Heap checker
+ * ============================================ */
+
+/*
+ * touch_forget - Drop the touched-ring entries that lie strictly inside
+ * the block of size bytes at bp: they were blocks of their own until
+ * bp absorbed them, and are no longer block boundaries.
+ *
+ * Return: nothing.
+ */
+static void touch_forget(Arena *ar, const char *bp, size_t size) {
+    for (unsigned k = 0; k < TOUCH_COUNT; ++k) {
+        if (ar->touched[k] > bp && ar->touched[k] < bp + size) ar->touched[k] = nullptr;
+    }
+}
+
+/*
+ * check_fail - Report one inconsistency found at bp.
+ *
+ * Return: 1, to be added to the caller's error count.
+ */
+static int check_fail(const char *what, const void *bp) {
+    fprintf(stderr, "mm_check: %s at %p\n", what, bp);
+    return 1;
+}
+
+/*
+ * check_owned - Tell whether p lies in a heap page of ar that is not a
+ * slab run, so that a header can be read there.
+ *
+ * Return: true if p is inside one of ar's regions.
+ */
+static bool check_owned(const Arena *ar, const void *p) {
+    size_t offset = static_cast<size_t>((const char*)p - heap_base);
+    return offset < mem_maxheap() &&
+           page_owner[offset >> PAGE_SHIFT] == static_cast<uint8_t>((ar - arenas) + 1);
+}
+
+/*
+ * check_free_entry - Check one block found in bin (fl, sl) of ar, or in
+ * the address tree if fl is -1: it must lie in ar's heap, be aligned,
+ * be marked free with a matching footer, and belong where it was found.
+ *
+ * Return: number of problems found.
+ */
+static int check_free_entry(Arena *ar, char *bp, int fl, int sl) {
+    if (!check_owned(ar, HDRP(bp)) || (uintptr_t)bp % ALIGNMENT != 0)
+        return check_fail("free-list entry outside the arena's heap", bp);
+
+    size_t size = GET_SIZE(HDRP(bp));
+    if (GET_ALLOC(HDRP(bp)))
+        return check_fail("block on a free list is marked allocated", bp);
+    if (size < MIN_BLOCK_SIZE || size % ALIGNMENT != 0 || !check_owned(ar, FTRP(bp)))
+        return check_fail("free block has a bad size", bp);
+    if ((GET(FTRP(bp)) & ~PURGE_BITS) != PACK(size, 0, 0))
+        return check_fail("free block header and footer disagree", bp);
+
+    int want_fl, want_sl;
+    mapping_insert(size, &want_fl, &want_sl);
+    bool in_tree = fit_policy == FIT_ADDRESS && size >= TREE_MIN_BLOCK;
+    if (fl < 0 ? !in_tree : (in_tree || fl != want_fl || sl != want_sl))
+        return check_fail("free block is in the wrong bin", bp);
+    return 0;
+}
+
+/*
+ * check_tree - Check the subtree t of bin (fl, sl), or of the address
+ * tree if fl is -1, whose keys must all sort strictly between lo and hi
+ * (nullptr for no bound). Verifies every node as a free entry, the key
+ * order, the heap order of priorities and every TREE_MAX, and adds the
+ * number of nodes to *count.
+ *
+ * The strict key bounds also catch a child link pointing back up the
+ * tree, so a corrupted tree cannot make the walk loop.
+ *
+ * Return: number of problems found.
+ */
+static int check_tree(Arena *ar, char *t, int fl, int sl, const char *lo, const char *hi,
+                      size_t *count) {
+    if (t == nullptr) return 0;
+
+    int errors = check_free_entry(ar, t, fl, sl);
+    if (errors != 0) return errors;
+    if ((lo != nullptr && !tree_before(lo, t)) || (hi != nullptr && !tree_before(t, hi)))
+        return check_fail("free tree is out of key order", t);
+    ++*count;
+
+    char        *kids[2] = {TREE_LEFT(t), TREE_RIGHT(t)};
+    word_t       max     = GET_SIZE(HDRP(t));
+    for (char *kid : kids) {
+        if (kid != nullptr && tree_priority(kid) > tree_priority(t))
+            errors += check_fail("free tree is out of heap order", kid);
+    }
+    errors += check_tree(ar, kids[0], fl, sl, lo, t, count);
+    errors += check_tree(ar, kids[1], fl, sl, t, hi, count);
+    if (errors != 0) return errors;
+
+    for (char *kid : kids) {
+        if (kid != nullptr && TREE_MAX(kid) > max) max = TREE_MAX(kid);
+    }
+    if (TREE_MAX(t) != max) errors += check_fail("free tree node has a stale TREE_MAX", t);
+    return errors;
+}
+
+/*
+ * check_free_lists - Check every free structure of ar: the bitmaps
+ * against the bins, each bin's list or tree, the address tree and the
+ * quick lists. Adds the number of free blocks found to *count.
+ *
+ * List walks stop after as many blocks as the heap could hold, so a
+ * cycle is reported instead of looping.
+ *
+ * Return: number of problems found.
+ */
+static int check_free_lists(Arena *ar, size_t *count) {
+    int    errors = 0;
+    size_t limit  = mem_heapsize() / MIN_BLOCK_SIZE;
+
+    for (int fl = 0; fl < FL_COUNT; ++fl) {
+        if (((ar->fl_bitmap >> fl) & 1) != (ar->sl_bitmap[fl] != 0))
+            errors += check_fail("first-level bitmap disagrees with its bins", &ar->sl_bitmap[fl]);
+
+        for (int sl = 0; sl < SL_COUNT; ++sl) {
+            char *head = ar->free_lists[fl][sl];
+            if (((ar->sl_bitmap[fl] >> sl) & 1) != (head != nullptr))
+                errors += check_fail("second-level bitmap disagrees with its bin", &ar->free_lists[fl][sl]);
+
+            if (bin_is_tree(fl)) {
+                errors += check_tree(ar, head, fl, sl, nullptr, nullptr, count);
+                continue;
+            }
+
+            char  *prev = nullptr;
+            size_t n    = 0;
+            for (char *bp = head; bp != nullptr; prev = bp, bp = (char*)GET_NEXT_FREE(bp)) {
+                if (++n > limit) {
+                    errors += check_fail("free list has a cycle", head);
+                    break;
+                }
+                int bad = check_free_entry(ar, bp, fl, sl);
+                if (bad == 0 && GET_PREV_FREE(bp) != prev)
+                    bad = check_fail("free list links disagree (next->prev != node)", bp);
+                errors += bad;
+                if (bad != 0) break;
+                ++*count;
+            }
+        }
+    }
+    errors += check_tree(ar, ar->addr_tree, -1, 0, nullptr, nullptr, count);
+
+    for (int idx = 0; idx < QUICK_COUNT; ++idx) {
+        int   n  = 0;
+        char *bp = ar->quick_lists[idx];
+        for (; bp != nullptr && n <= QUICK_LIST_MAX; bp = (char*)GET_NEXT_FREE(bp), ++n) {
+            if (!check_owned(ar, HDRP(bp)) || !GET_ALLOC(HDRP(bp)) ||
+                GET_SIZE(HDRP(bp)) != QUICK_MIN_SIZE + idx * ALIGNMENT)
+                break;
+        }
+        if (bp != nullptr)                  errors += check_fail("quick list is broken", bp);
+        else if (n != ar->quick_counts[idx]) errors += check_fail("quick list count is wrong", ar->quick_lists[idx]);
+    }
+    return errors;
+}
+
+/*
+ * check_regions - Walk every block of the regions that fill the
+ * pages [lo, hi) back to back, adding the number of free blocks seen to
+ * *nfree.
+ *
+ * Checks each region's prologue and epilogue, and for every block its
+ * alignment, size, bounds and prev-allocated bit; free blocks must have
+ * a matching footer and no free neighbor, and in hardened mode
+ * allocated blocks must have an intact seal. A block whose size would run
+ * past hi ends the walk, since nothing after it can be located.
+ *
+ * Return: number of problems found.
+ */
+static int check_regions(char *lo, char *hi, size_t *nfree) {
+    int   errors = 0;
+    char *base   = lo;
+
+    while (base < hi) {
+        if (GET(base) != 0 || GET(base + WSIZE) != PACK(DSIZE, 1, 1) ||
+            GET(base + 2 * WSIZE) != PACK(DSIZE, 1, 1))
+            return errors + check_fail("bad region prologue", base);
+
+        char *bp        = base + REGION_OVERHEAD;
+        bool  prev_free = false;
+        for (; GET_SIZE(HDRP(bp)) != 0; bp = NEXT_BLKP(bp)) {
+            size_t size = GET_SIZE(HDRP(bp));
+            if ((uintptr_t)bp % ALIGNMENT != 0)
+                errors += check_fail("block payload is misaligned", bp);
+            if (size < MIN_BLOCK_SIZE || size % ALIGNMENT != 0 || bp + size > hi)
+                return errors + check_fail("block size runs outside its region", bp);
+            if (GET_PREV_ALLOC(HDRP(bp)) == prev_free)
+                errors += check_fail("prev-allocated bit disagrees with the previous block", bp);
+
+            bool is_free = !GET_ALLOC(HDRP(bp));
+            if (HARDEN && !is_free && GET(FTRP(bp)) != block_seal(bp, size))
+                errors += check_fail("allocated block's seal is broken (overflow?)", bp);
+            if (is_free) {
+                ++*nfree;
+                if ((GET(FTRP(bp)) & ~PURGE_BITS) != PACK(size, 0, 0))
+                    errors += check_fail("free block header and footer disagree", bp);
+                if (prev_free)
+                    errors += check_fail("adjacent free blocks escaped coalescing", bp);
+            }
+            prev_free = is_free;
+        }
+
+        if (!GET_ALLOC(HDRP(bp)) || GET_PREV_ALLOC(HDRP(bp)) == prev_free)
+            errors += check_fail("bad region epilogue", HDRP(bp));
+        base = bp;                          /* The next region starts after the epilogue */
+    }
+    return errors;
+}
+
+/*
+ * check_slab_run - Check a slab run descriptor: a valid class, the slot
+ * count for that class, no free bits past the last slot, and nfree equal
+ * to the number of free bits.
+ *
+ * Return: number of problems found.
+ */
+static int check_slab_run(const SlabRun *run) {
+    if (run->cls >= SLAB_COUNT || run->nslots != (CHUNKSIZE - SLAB_HDR_SIZE) / SLAB_SIZES[run->cls])
+        return check_fail("slab run has a bad class or slot count", run);
+
+    int free_bits = 0;
+    for (int w = 0; w < SLAB_MAP_WORDS; ++w) {
+        uint64_t word = run->free_map[w];
+        int      past = run->nslots - 64 * w;          /* Valid bits in this word */
+        if (past < 64) {
+            uint64_t valid = past > 0 ? (uint64_t(1) << past) - 1 : 0;
+            if (word & ~valid) return check_fail("slab run marks slots past its end free", run);
+        }
+        free_bits += __builtin_popcountll(word);
+    }
+    if (free_bits != run->nfree) return check_fail("slab run nfree disagrees with its free map", run);
+    return 0;
+}
+
+/*
+ * check_slab_lists - Check ar's partial and empty run lists: each run is
+ * one of ar's slab pages, partial runs are linked both ways, have the
+ * list's class and a free slot, and empty runs are wholly free.
+ *
+ * Return: number of problems found.
+ */
+static int check_slab_lists(Arena *ar) {
+    int     errors = 0;
+    size_t  limit  = mem_heapsize() >> PAGE_SHIFT;
+    uint8_t tag    = static_cast<uint8_t>((ar - arenas) + 1) | PAGE_SLAB;
+
+    auto is_run = [&](const SlabRun *run) {
+        size_t offset = static_cast<size_t>((const char*)run - heap_base);
+        return offset < mem_heapsize() && offset % CHUNKSIZE == 0 &&
+               page_owner[offset >> PAGE_SHIFT] == tag;
+    };
+
+    for (int cls = 0; cls < SLAB_COUNT; ++cls) {
+        SlabRun *prev = nullptr;
+        size_t   n    = 0;
+        for (SlabRun *run = ar->slab_partial[cls]; run != nullptr; prev = run, run = run->next) {
+            if (++n > limit || !is_run(run) || run->prev != prev) {
+                errors += check_fail("slab partial list is broken", run);
+                break;
+            }
+            if (run->cls != cls || run->nfree == 0)
+                errors += check_fail("full or misclassed run on a partial list", run);
+        }
+    }
+
+    size_t n = 0;
+    for (SlabRun *run = ar->slab_empty; run != nullptr; run = run->next) {
+        if (++n > limit || !is_run(run)) {
+            errors += check_fail("slab empty list is broken", run);
+            break;
+        }
+        if (run->nfree != run->nslots) errors += check_fail("used run on the empty list", run);
+    }
+    return errors;
+}
+
+/*
+ * check_listed - Find the free block bp in the bin or tree it belongs
+ * to, as far as that can be done without walking a whole list: a list
+ * block's neighbors must link back to it (or the bin head must be bp),
+ * and a tree block must be reachable from its root by key.
+ *
+ * Return: true if bp is linked in where it should be.
+ */
+static bool check_listed(Arena *ar, char *bp) {
+    size_t size = GET_SIZE(HDRP(bp));
+    int    fl, sl;
+    char  *root;
+
+    mapping_insert(size, &fl, &sl);
+    if (fit_policy == FIT_ADDRESS && size >= TREE_MIN_BLOCK) {
+        root = ar->addr_tree;
+    } else if (bin_is_tree(fl)) {
+        root = ar->free_lists[fl][sl];
+    } else {
+        char *prev = (char*)GET_PREV_FREE(bp);
+        char *next = (char*)GET_NEXT_FREE(bp);
+        if (prev == nullptr ? ar->free_lists[fl][sl] != bp
+                            : !check_owned(ar, HDRP(prev)) || GET_NEXT_FREE(prev) != bp)
+            return false;
+        return next == nullptr || (check_owned(ar, HDRP(next)) && GET_PREV_FREE(next) == bp);
+    }
+
+    /* Treaps stay shallow; a search this long means the tree is broken */
+    for (int depth = 0; root != nullptr && depth < 256; ++depth) {
+        if (root == bp) return true;
+        if (!check_owned(ar, HDRP(root))) return false;
+        root = tree_before(bp, root) ? TREE_LEFT(root) : TREE_RIGHT(root);
+    }
+    return false;
+}
+
+/*
+ * check_touched - Check one block from ar's touched ring, and its links
+ * to its neighbors: alignment, size and bounds; the next block's
+ * prev-allocated bit; for a free block, its footer, that neither
+ * neighbor is free and that it is linked into its bin; for an allocated
+ * block after a free one, that the free block's footer leads back to a
+ * matching header.
+ *
+ * Return: number of problems found.
+ */
+static int check_touched(Arena *ar, char *bp) {
+    if (!check_owned(ar, HDRP(bp)) || (uintptr_t)bp % ALIGNMENT != 0)
+        return check_fail("touched block outside the arena's heap", bp);
+
+    size_t size = GET_SIZE(HDRP(bp));
+    if (size < MIN_BLOCK_SIZE || size % ALIGNMENT != 0 || !check_owned(ar, HDRP(NEXT_BLKP(bp))))
+        return check_fail("block size runs outside its region", bp);
+
+    char *next  = NEXT_BLKP(bp);
+    bool  alloc = GET_ALLOC(HDRP(bp));
+    int   errors = 0;
+    if (GET_PREV_ALLOC(HDRP(next)) != alloc)
+        errors += check_fail("prev-allocated bit disagrees with the previous block", next);
+
+    if (!alloc) {
+        if ((GET(FTRP(bp)) & ~PURGE_BITS) != PACK(size, 0, 0))
+            return errors + check_fail("free block header and footer disagree", bp);
+        if (!GET_PREV_ALLOC(HDRP(bp)) || !GET_ALLOC(HDRP(next)))
+            errors += check_fail("adjacent free blocks escaped coalescing", bp);
+        if (!check_listed(ar, bp))
+            errors += check_fail("free block is missing from its free list", bp);
+    } else if (!GET_PREV_ALLOC(HDRP(bp))) {
+        char *prev = PREV_BLKP(bp);
+        if (!check_owned(ar, HDRP(prev)) || GET_ALLOC(HDRP(prev)) ||
+            GET_SIZE(HDRP(prev)) != (size_t)(bp - prev))
+            errors += check_fail("previous free block's footer does not match its header", bp);
+    }
+    return errors;
+}
+
+/*
+ * mm_check - Check the whole heap for consistency.
+ *
+ * For every arena, under its lock and sbrk_lock, with the page map as
+ * the guide to which pages hold its regions and slab runs:
+ *   1. Every block in the free lists and trees is marked free, lies in
+ *      the arena's heap and sits in the bin its size maps to.
+ *   2. No two adjacent free blocks exist (escaped coalescing).
+ *   3. Every free block in the heap appears in the free structures: the
+ *      free blocks met walking the regions must number exactly as many
+ *      as those met walking the lists and trees.
+ *   4. Free lists are doubly-linked consistently (node->next->prev ==
+ *      node) and acyclic; trees are in key and heap order with correct
+ *      TREE_MAX; bitmaps match the bins.
+ *   5. No block extends outside its region, and every region has its
+ *      prologue and epilogue.
+ *   6. Every payload is ALIGNMENT-aligned; header and footer of each free
+ *      block agree; each prev-allocated bit matches the block before.
+ * Slab runs must have nfree equal to the popcount of their free map,
+ * and their partial and empty lists must be well formed.
+ *
+ * Each problem is printed to stderr. The walk is O(heap size); see
+ * mm_check_incremental for a check cheap enough to run after every call.
+ * Also clears the touched rings.
+ *
+ * Return: 0 if consistent, otherwise the number of problems found.
+ */
+int mm_check(void) {
+    int errors = 0;
+
+    for (int i = 0; i < narenas; ++i) {
+        Arena *ar = &arenas[i];
+        std::lock_guard<std::mutex> guard(ar->lock);
+        std::lock_guard<std::mutex> sbrk_guard(sbrk_lock);
+
+        size_t  listed = 0, walked = 0;
+        size_t  npages = mem_heapsize() >> PAGE_SHIFT;
+        uint8_t tag    = static_cast<uint8_t>(i + 1);
+
+        int list_errors = check_free_lists(ar, &listed);
+        errors += list_errors;
+        errors += check_slab_lists(ar);
+
+        for (size_t p = 0; p < npages; ) {
+            char *page = heap_base + (p << PAGE_SHIFT);
+            if (page_owner[p] == (tag | PAGE_SLAB)) {
+                errors += check_slab_run(reinterpret_cast<SlabRun *>(page));
+                ++p;
+            } else if (page_owner[p] == tag) {
+                size_t q = p;
+                while (q < npages && page_owner[q] == tag) ++q;
+                errors += check_regions(page, heap_base + (q << PAGE_SHIFT), &walked);
+                p = q;
+            } else {
+                ++p;
+            }
+        }
+
+        if (list_errors == 0 && walked != listed)
+            errors += check_fail("free blocks in the heap are missing from the free lists", ar);
+        memset(ar->touched, 0, sizeof(ar->touched));
+    }
+    return errors;
+}
+
+/*
+ * mm_check_incremental - Check only what changed since the last check.
+ *
+ * Each arena's touched ring holds the blocks and slab slots its recent
+ * operations allocated, freed, split, merged or resized (at least all
+ * of them for its latest operation). Every entry is checked with
+ * check_touched, which also covers the block's neighbors and its links
+ * into its bin, or, for a slab slot, with check_slab_run on its run;
+ * then the ring is cleared. The cost is a few dozen header reads per
+ * arena, whatever the heap size.
+ *
+ * Return: 0 if consistent, otherwise the number of problems found.
+ */
+int mm_check_incremental(void) {
+    int errors = 0;
+
+    for (int i = 0; i < narenas; ++i) {
+        Arena *ar = &arenas[i];
+        std::lock_guard<std::mutex> guard(ar->lock);
+
+        for (unsigned k = 0; k < TOUCH_COUNT; ++k) {
+            char *bp = ar->touched[k];
+            if (bp == nullptr) continue;
+            ar->touched[k] = nullptr;
+            errors += is_slab(bp) ? check_slab_run(slab_run_of(bp)) : check_touched(ar, bp);
+        }
+    }
+    return errors;
+}
@@ -1,21 +1,134 @@
-#ifndef ALLOCATOR_H
-#define ALLOCATOR_H
-
-#include <stddef.h>
-
-/* Initialize the allocator - called once before any malloc/free calls */
-int mm_init(void);
-
-/* Allocate a block of at least size bytes */
-void *mm_malloc(size_t size);
-
-/* Free a previously allocated block */
-void mm_free(void *ptr);
-
-/* Optional: Resize a previously allocated block (extra credit) */
-void *mm_realloc(void *ptr, size_t size);
-
-/* Optional: Check heap consistency (useful for debugging) */
-int mm_check(void);
-
-#endif /* ALLOCATOR_H */
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stddef.h>
+
+/*
+ * Alignment of every payload mm_malloc returns: 16 bytes by default on
+ * x86-64, as the system allocator gives, so __m128 and long double data
+ * can live in any block; 8 elsewhere. Build with -DMM_ALIGNMENT=8 or 16
+ * to choose.
+ */
+#ifndef MM_ALIGNMENT
+#if defined(__x86_64__)
+#define MM_ALIGNMENT 16
+#else
+#define MM_ALIGNMENT 8
+#endif
+#endif
+
+/*
+ * Width of the block header word. Headers are 4 bytes by default, which
+ * keeps heap blocks below 4 GB; larger requests are mapped instead. Build
+ * with -DMM_WIDE_HEADERS=1 for 8-byte headers and heap blocks of any size
+ * memlib can reserve.
+ */
+#ifndef MM_WIDE_HEADERS
+#define MM_WIDE_HEADERS 0
+#endif
+
+/* Initialize the allocator - called once before any malloc/free calls */
+int mm_init(void);
+
+/* Allocate a block of at least size bytes */
+void *mm_malloc(size_t size);
+
+/*
+ * Allocate zeroed space for nmemb elements of size bytes each; nullptr
+ * if the total overflows, is 0, or cannot be allocated
+ */
+void *mm_calloc(size_t nmemb, size_t size);
+
+/*
+ * Allocate size bytes at an address that is a multiple of alignment,
+ * which must be a power of two; nullptr otherwise or on failure.
+ * mm_aligned_alloc is the same call under its C11 name.
+ */
+void *mm_memalign(size_t alignment, size_t size);
+void *mm_aligned_alloc(size_t alignment, size_t size);
+
+/* Free a previously allocated block */
+void mm_free(void *ptr);
+
+/* Optional: Resize a previously allocated block (extra credit) */
+void *mm_realloc(void *ptr, size_t size);
+
+/*
+ * Usable size of an allocated block: at least what was requested, plus
+ * any slack the allocator rounded it up by, all of which the caller may
+ * write. 0 for nullptr. mm_malloc_at_least allocates like mm_malloc and
+ * stores that size in *actual (0 on failure) unless actual is nullptr.
+ */
+size_t mm_usable_size(void *ptr);
+void *mm_malloc_at_least(size_t size, size_t *actual);
+
+/*
+ * Check heap consistency; each problem found is printed to stderr.
+ * mm_check walks the whole heap. mm_check_incremental only checks the
+ * blocks touched by the most recent operations (at least the latest one
+ * in each arena) and their neighbors, in time independent of heap size.
+ * Both return 0 if consistent, else the number of problems found.
+ */
+int mm_check(void);
+int mm_check_incremental(void);
+
+/*
+ * Allocator statistics, filled in by mm_get_stats.
+ *
+ * Counts cover everything since the last mm_init. Size classes are by
+ * usable size: class i holds blocks of at most class_max[i] bytes (and
+ * more than class_max[i - 1]). A realloc that changes a block's class in
+ * place counts as a free from the old class and a malloc in the new one.
+ */
+#define MM_STATS_CLASSES 32
+
+struct mm_stats {
+    size_t heap_size;          /* mem_heapsize()                              */
+    size_t bytes_allocated;    /* Heap bytes not free (live and thread-cached
+                                  blocks, headers, sentinels), plus mapped   */
+    size_t bytes_free;         /* Free heap blocks plus free slab slots       */
+    size_t free_blocks;        /* Number of free heap blocks                  */
+    size_t largest_free;       /* Size of the largest free heap block         */
+    double fragmentation;      /* 1 - largest_free / free heap block bytes    */
+    size_t mapped_bytes;       /* Bytes in live mapped (large) blocks         */
+    unsigned long extend_heap_calls;
+    size_t        class_max[MM_STATS_CLASSES];
+    unsigned long mallocs[MM_STATS_CLASSES];
+    unsigned long frees[MM_STATS_CLASSES];
+};
+
+/* Fill in *stats; safe to call while other threads allocate */
+void mm_get_stats(struct mm_stats *stats);
+
+/*
+ * Search-length and latency profile, filled in by mm_get_profile.
+ *
+ * Only recorded when the allocator is built with -DMM_PROFILE=1 (`make
+ * profile`); otherwise the hooks compile to nothing and mm_get_profile
+ * fails. Counts cover everything since the last mm_init.
+ *
+ * fit_nodes[i] is the number of find_fit calls that visited i free
+ * blocks before returning (the last entry also takes longer searches).
+ * Latencies are in CPU cycle-counter ticks, recorded in buckets with
+ * 4 steps per power of two; each percentile is the upper edge of the
+ * bucket it falls in, so it overstates the true value by under 25%.
+ */
+#define MM_FIT_BUCKETS 64
+
+struct mm_profile {
+    unsigned long fit_calls;
+    unsigned long fit_nodes[MM_FIT_BUCKETS];
+    unsigned long fit_p50, fit_p99, fit_p999;              /* Nodes visited */
+    unsigned long malloc_calls;
+    unsigned long malloc_p50, malloc_p99, malloc_p999;     /* Cycles        */
+    unsigned long free_calls;
+    unsigned long free_p50, free_p99, free_p999;           /* Cycles        */
+};
+
+/*
+ * Fill in *prof; safe to call while other threads allocate.
+ * Returns 0, or -1 if the allocator was built without MM_PROFILE.
+ */
+int mm_get_profile(struct mm_profile *prof);
+
+#endif /* ALLOCATOR_H */
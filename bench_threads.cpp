@@ -0,0 +1,156 @@
+/*
+ * Multi-threaded Throughput Benchmark  (C++17)
+ *
+ * Runs the same random malloc/free workload on 1, 2, 4, ... N threads and
+ * reports total throughput, first with every thread sharing one arena,
+ * then with one arena per thread, and finally with the system malloc
+ * for reference. The gap between the first two columns is the lock
+ * contention the arenas remove.
+ *
+ * Usage:
+ *   ./bench_threads                 — up to 2 x online CPUs threads
+ *   ./bench_threads <N> [ops]       — up to N threads, ops per thread
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include "allocator.h"
+#include "memlib.h"
+
+// ─────────────────────────────────────────────
+// Workload
+// ─────────────────────────────────────────────
+
+// Live blocks per thread; kept small so 32+ threads fit in memlib's heap
+constexpr int SLOTS = 128;
+
+using MallocFn = void *(*)(size_t);
+using FreeFn   = void (*)(void *);
+
+// Deterministic xorshift PRNG so every run replays the same operations
+static uint32_t next_rand(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// 90% small (tcache-sized) requests, 10% medium ones that reach the arena
+static size_t pick_size(uint32_t &seed) {
+    uint32_t r = next_rand(seed);
+    return (r % 10 != 0) ? 8 + r % 500 : 1024 + r % 7168;
+}
+
+// One thread's share: random malloc/free over SLOTS live blocks
+static void worker(MallocFn do_malloc, FreeFn do_free, uint32_t seed,
+                   long ops, std::atomic<long> &failures) {
+    void *slots[SLOTS] = {};
+
+    for (long i = 0; i < ops; ++i) {
+        int k = static_cast<int>(next_rand(seed) % SLOTS);
+        if (slots[k] != nullptr) {
+            do_free(slots[k]);
+            slots[k] = nullptr;
+        } else {
+            size_t size = pick_size(seed);
+            slots[k] = do_malloc(size);
+            if (slots[k] == nullptr) ++failures;
+            else static_cast<char *>(slots[k])[0] = 1;   // touch the block
+        }
+    }
+    for (auto *p : slots) do_free(p);
+}
+
+// Run the workload on `threads` threads; return total Mops/sec
+static double run(MallocFn do_malloc, FreeFn do_free, int threads, long ops,
+                  std::atomic<long> &failures) {
+    std::thread pool[256];
+    auto start = std::chrono::steady_clock::now();
+
+    for (int t = 0; t < threads; ++t)
+        pool[t] = std::thread(worker, do_malloc, do_free, 7919u * (t + 1), ops, std::ref(failures));
+    for (int t = 0; t < threads; ++t) pool[t].join();
+
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(ops) * threads / secs.count() / 1e6;
+}
+
+// Fresh memlib heap and allocator with the given number of arenas
+static bool reset_allocator(int arenas) {
+    setenv("MM_ARENAS", std::to_string(arenas).c_str(), 1);
+    mem_deinit();
+    mem_init();
+    return mm_init() == 0;
+}
+
+static void libc_free(void *p) { free(p); }
+
+// ─────────────────────────────────────────────
+// main
+// ─────────────────────────────────────────────
+
+int main(int argc, char *argv[]) {
+    unsigned cpus = std::thread::hardware_concurrency();
+    int  max_threads = (argc >= 2) ? std::stoi(argv[1]) : static_cast<int>(cpus ? 2 * cpus : 8);
+    long ops         = (argc >= 3) ? std::stol(argv[2]) : 200000;
+    if (max_threads < 1)   max_threads = 1;
+    if (max_threads > 256) max_threads = 256;
+
+    std::cout << "============================================\n";
+    std::cout << "  MULTI-THREADED THROUGHPUT (Mops/sec)\n";
+    std::cout << "  " << ops << " ops per thread, " << cpus << " CPUs online\n";
+    std::cout << "============================================\n\n";
+    std::cout << std::right
+              << std::setw(8)  << "threads"
+              << std::setw(12) << "1 arena"
+              << std::setw(12) << "N arenas"
+              << std::setw(12) << "libc" << "\n";
+
+    std::atomic<long> failures{0};
+
+    // Powers of two, then always end on N
+    for (int t = 1;; t = std::min(2 * t, max_threads)) {
+        double shared = 0, per_thread = 0;
+
+        if (reset_allocator(1))
+            shared = run(mm_malloc, mm_free, t, ops, failures);
+        if (reset_allocator(t))
+            per_thread = run(mm_malloc, mm_free, t, ops, failures);
+        double libc = run(malloc, libc_free, t, ops, failures);
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(8)  << t
+                  << std::setw(12) << shared
+                  << std::setw(12) << per_thread
+                  << std::setw(12) << libc << "\n";
+
+        if (t == max_threads) break;
+    }
+
+    // Only filled in by a `make profile` build; covers the last N-arena run
+    mm_profile prof;
+    if (mm_get_profile(&prof) == 0) {
+        std::cout << "\nProfile of the last N-arena run (p50 / p99 / p999):\n"
+                  << "  find_fit nodes   " << prof.fit_p50 << " / " << prof.fit_p99
+                  << " / " << prof.fit_p999 << "  (" << prof.fit_calls << " calls)\n"
+                  << "  malloc cycles    " << prof.malloc_p50 << " / " << prof.malloc_p99
+                  << " / " << prof.malloc_p999 << "\n"
+                  << "  free cycles      " << prof.free_p50 << " / " << prof.free_p99
+                  << " / " << prof.free_p999 << "\n";
+    }
+
+    mem_deinit();
+    if (failures > 0) {
+        std::cout << "\n" << failures << " allocations failed (heap exhausted)\n";
+        return 1;
+    }
+    return 0;
+}
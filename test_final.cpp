@@ -0,0 +1,1257 @@
+/*
+ * Final Test Suite  (C++17)
+ *
+ * Tests the whole allocator API on top of malloc correctness: free and
+ * heap reuse, realloc, calloc and memalign, threads, memory returned to
+ * the OS, statistics, heap checking, fit policies and build modes.
+ *
+ * Usage:
+ *   ./test_final        — run all tests, print summary
+ *   ./test_final <N>    — run only test N (1-indexed), exit 0=pass 1=fail
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstring>
+#include <iomanip>
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <csignal>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "allocator.h"
+#include "memlib.h"
+
+// ─────────────────────────────────────────────
+// Minimal test framework
+// ─────────────────────────────────────────────
+
+struct TestResult {
+    std::string name;
+    bool        passed = false;
+    std::string failure_msg;
+};
+
+// All registered test cases
+static std::vector<std::pair<std::string, std::function<TestResult()>>> g_tests;
+
+// Register a test
+static void register_test(const std::string &name,
+                           std::function<TestResult()> fn) {
+    g_tests.emplace_back(name, std::move(fn));
+}
+
+// Convenience: make a passing result
+static TestResult pass(const std::string &name) {
+    return { name, true, "" };
+}
+
+// Convenience: make a failing result
+static TestResult fail(const std::string &name, const std::string &msg) {
+    return { name, false, msg };
+}
+
+// ─────────────────────────────────────────────
+// Helpers
+// ─────────────────────────────────────────────
+
+static bool is_aligned(const void *ptr) {
+    return (reinterpret_cast<uintptr_t>(ptr) % MM_ALIGNMENT) == 0;
+}
+
+// A block header or footer word, as the allocator lays it out
+#if MM_WIDE_HEADERS
+typedef uint64_t header_word;
+#else
+typedef uint32_t header_word;
+#endif
+
+// Reinitialise the allocator between independent test runs
+static bool reset_allocator() {
+    mem_deinit();
+    mem_init();
+    return mm_init() == 0;
+}
+
+// Deterministic xorshift PRNG so failures are reproducible
+static uint32_t next_rand(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// ─────────────────────────────────────────────
+// Test definitions
+// ─────────────────────────────────────────────
+
+// Test 1 — free(nullptr) is a no-op
+static TestResult test_free_null() {
+    const std::string name = "free(nullptr) is a no-op";
+    mm_free(nullptr);
+
+    void *ptr = mm_malloc(16);
+    if (ptr == nullptr)
+        return fail(name, "malloc failed after free(nullptr) — free must ignore nullptr");
+
+    return pass(name);
+}
+
+// Test 2 — a freed block is reused by the next same-size request
+static TestResult test_free_reuse() {
+    const std::string name = "Freed block is reused";
+    void *a = mm_malloc(64);
+    void *guard = mm_malloc(64);   // keeps a away from the free tail
+    if (a == nullptr || guard == nullptr)
+        return fail(name, "malloc returned nullptr");
+
+    mm_free(a);
+    void *b = mm_malloc(64);
+    if (b != a)
+        return fail(name, "same-size malloc after free did not reuse the block — check add_to_free_list");
+
+    return pass(name);
+}
+
+// Test 3 — adjacent freed blocks coalesce into one larger block
+static TestResult test_coalesce_neighbors() {
+    const std::string name = "Adjacent free blocks coalesce";
+    void *a = mm_malloc(1000);
+    void *b = mm_malloc(1000);
+    void *c = mm_malloc(1000);
+    void *guard = mm_malloc(1000);
+    if (a == nullptr || b == nullptr || c == nullptr || guard == nullptr)
+        return fail(name, "malloc returned nullptr");
+
+    // Free outer blocks first, then the middle one: exercises cases 2, 3 and 4
+    mm_free(a);
+    mm_free(c);
+    mm_free(b);
+
+    void *big = mm_malloc(3000);
+    if (big != a)
+        return fail(name, "3000 B request did not land in the merged a+b+c block — check coalesce()");
+
+    return pass(name);
+}
+
+// Test 4 — repeated malloc/free cycles must not grow the heap
+static TestResult test_no_leak_cycles() {
+    const std::string name = "malloc/free cycles do not leak";
+    constexpr int N = 64;
+    void *ptrs[N];
+
+    size_t baseline = 0;
+    for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < N; ++i) {
+            ptrs[i] = mm_malloc(32 + 48 * (i % 7));
+            if (ptrs[i] == nullptr)
+                return fail(name, "malloc returned nullptr — freed memory is not being reused");
+        }
+        for (int i = 0; i < N; ++i) mm_free(ptrs[i]);
+
+        if (round == 0) baseline = mem_heapsize();
+        else if (mem_heapsize() != baseline)
+            return fail(name, "heap kept growing across identical rounds — free is leaking blocks");
+    }
+
+    return pass(name);
+}
+
+// Test 5 — random interleaved malloc/free keeps every live block intact
+static TestResult test_random_pattern() {
+    const std::string name = "Random malloc/free pattern";
+    constexpr int N = 256;
+    unsigned char *ptrs[N]  = {};
+    size_t         sizes[N] = {};
+    uint32_t       seed     = 12345;
+
+    for (int step = 0; step < 20000; ++step) {
+        int i = static_cast<int>(next_rand(seed) % N);
+        if (ptrs[i] != nullptr) {
+            for (size_t j = 0; j < sizes[i]; ++j) {
+                if (ptrs[i][j] != static_cast<unsigned char>(i))
+                    return fail(name, "data corruption — a free or split overwrote a live block");
+            }
+            mm_free(ptrs[i]);
+            ptrs[i] = nullptr;
+        } else {
+            sizes[i] = 1 + next_rand(seed) % 2048;
+            ptrs[i]  = static_cast<unsigned char *>(mm_malloc(sizes[i]));
+            if (ptrs[i] == nullptr)
+                return fail(name, "malloc returned nullptr — heap exhausted, check coalescing");
+            if (!is_aligned(ptrs[i]))
+                return fail(name, "returned pointer is not MM_ALIGNMENT-aligned");
+            std::memset(ptrs[i], i, sizes[i]);
+        }
+    }
+
+    if (mm_check() != 0)
+        return fail(name, "mm_check reported an inconsistent heap");
+
+    return pass(name);
+}
+
+// Test 6 — realloc grows in place into a free neighbor and at the heap tail
+static TestResult test_realloc_in_place() {
+    const std::string name = "realloc grows in place";
+    auto *p = static_cast<unsigned char *>(mm_malloc(1000));
+    void *next = mm_malloc(1000);
+    void *guard = mm_malloc(1000);
+    if (p == nullptr || next == nullptr || guard == nullptr)
+        return fail(name, "malloc returned nullptr");
+    std::memset(p, 0x5A, 1000);
+
+    // Free neighbor: growing into it must not move the block
+    mm_free(next);
+    if (mm_realloc(p, 1800) != p)
+        return fail(name, "realloc moved the block although the next block was free");
+
+    // Last block in the heap: growing must extend the heap in place
+    auto *tail = static_cast<unsigned char *>(mm_realloc(guard, 64 * 1024));
+    if (tail != guard)
+        return fail(name, "realloc of the last block moved it instead of extending the heap");
+
+    // Shrinking never moves the block
+    if (mm_realloc(p, 100) != p)
+        return fail(name, "shrinking realloc moved the block");
+
+    for (int j = 0; j < 100; ++j) {
+        if (p[j] != 0x5A)
+            return fail(name, "data lost during in-place realloc");
+    }
+
+    return pass(name);
+}
+
+// Test 7 — realloc that must move preserves the old contents
+static TestResult test_realloc_copy() {
+    const std::string name = "realloc preserves data when moving";
+    auto *p = static_cast<unsigned char *>(mm_malloc(200));
+    void *blocker = mm_malloc(200);   // next block stays allocated
+    if (p == nullptr || blocker == nullptr)
+        return fail(name, "malloc returned nullptr");
+    for (int j = 0; j < 200; ++j) p[j] = static_cast<unsigned char>(j);
+
+    auto *q = static_cast<unsigned char *>(mm_realloc(p, 5000));
+    if (q == nullptr)
+        return fail(name, "realloc returned nullptr");
+    for (int j = 0; j < 200; ++j) {
+        if (q[j] != static_cast<unsigned char>(j))
+            return fail(name, "realloc did not copy the old payload");
+    }
+
+    return pass(name);
+}
+
+// Test 8 — several threads malloc/free concurrently without corrupting blocks
+static TestResult test_threads() {
+    const std::string name = "Concurrent malloc/free from 4 threads";
+    constexpr int THREADS = 4;
+    std::atomic<bool> corrupted{false};
+    std::atomic<bool> exhausted{false};
+
+    auto worker = [&](uint32_t seed) {
+        constexpr int N = 64;
+        unsigned char *ptrs[N]  = {};
+        size_t         sizes[N] = {};
+        unsigned char  tag      = static_cast<unsigned char>(seed);
+
+        for (int step = 0; step < 20000 && !corrupted && !exhausted; ++step) {
+            int i = static_cast<int>(next_rand(seed) % N);
+            if (ptrs[i] != nullptr) {
+                for (size_t j = 0; j < sizes[i]; ++j) {
+                    if (ptrs[i][j] != tag) corrupted = true;
+                }
+                mm_free(ptrs[i]);
+                ptrs[i] = nullptr;
+            } else {
+                sizes[i] = 1 + next_rand(seed) % 600;
+                ptrs[i]  = static_cast<unsigned char *>(mm_malloc(sizes[i]));
+                if (ptrs[i] == nullptr) { exhausted = true; break; }
+                std::memset(ptrs[i], tag, sizes[i]);
+            }
+        }
+        for (int i = 0; i < N; ++i) mm_free(ptrs[i]);
+    };
+
+    std::thread threads[THREADS];
+    for (int t = 0; t < THREADS; ++t) threads[t] = std::thread(worker, 1000u + t);
+    for (auto &th : threads) th.join();
+
+    if (exhausted)
+        return fail(name, "malloc returned nullptr under concurrency — heap exhausted");
+    if (corrupted)
+        return fail(name, "data corruption — two threads were handed overlapping blocks");
+
+    return pass(name);
+}
+
+// Test 9 — blocks freed by another thread go back to the arena that owns them
+static TestResult test_cross_thread_free() {
+    const std::string name = "Cross-thread frees with 4 arenas";
+    setenv("MM_ARENAS", "4", 1);
+    bool ok = reset_allocator();
+    unsetenv("MM_ARENAS");
+    if (!ok)
+        return fail(name, "mm_init() failed with MM_ARENAS=4");
+
+    constexpr int N = 200;
+    void  *ptrs[N];
+    size_t heap_after_warmup = 0;
+    bool   exhausted = false;
+
+    for (int round = 0; round < 20 && !exhausted; ++round) {
+        // Producer allocates a mix of tcache-sized and larger blocks...
+        std::thread producer([&] {
+            for (int i = 0; i < N; ++i) {
+                ptrs[i] = mm_malloc((i % 5 == 0) ? 3000 : 40 + 8 * (i % 20));
+                if (ptrs[i] == nullptr) { exhausted = true; return; }
+            }
+        });
+        producer.join();
+        if (exhausted) break;
+
+        // ...and a consumer, bound to a different arena, frees them all
+        std::thread consumer([&] {
+            for (int i = 0; i < N; ++i) mm_free(ptrs[i]);
+        });
+        consumer.join();
+
+        if (round == 2) heap_after_warmup = mem_heapsize();
+    }
+
+    if (exhausted)
+        return fail(name, "malloc returned nullptr — remote frees are not reaching the owning arena");
+    if (mem_heapsize() != heap_after_warmup)
+        return fail(name, "heap kept growing — blocks freed by another thread are being leaked");
+
+    return pass(name);
+}
+
+// Producer and consumer run at the same time, handing blocks over a ring;
+// every free lands on the producer's arena from a thread bound elsewhere
+static TestResult test_pipeline_free() {
+    const std::string name = "Producer/consumer pipeline with 2 arenas";
+    setenv("MM_ARENAS", "2", 1);
+    bool ok = reset_allocator();
+    unsetenv("MM_ARENAS");
+    if (!ok)
+        return fail(name, "mm_init() failed with MM_ARENAS=2");
+
+    constexpr int  RING  = 64;
+    constexpr long ITEMS = 50000;
+    struct Item { unsigned char *p; size_t size; };
+    Item ring[RING];
+    std::atomic<long> head{0}, tail{0};
+    std::atomic<bool> exhausted{false}, corrupt{false};
+
+    std::thread producer([&] {
+        uint32_t seed = 4242;
+        for (long i = 0; i < ITEMS && !exhausted; ++i) {
+            size_t size = (i % 8 == 0) ? 1024 + next_rand(seed) % 4096
+                                       : 8 + next_rand(seed) % 500;
+            auto *p = static_cast<unsigned char *>(mm_malloc(size));
+            if (p == nullptr) { exhausted = true; break; }
+            std::memset(p, static_cast<int>(i & 0xFF), size);
+
+            while (head.load(std::memory_order_relaxed) -
+                   tail.load(std::memory_order_acquire) == RING)
+                std::this_thread::yield();
+            ring[head % RING] = {p, size};
+            head.fetch_add(1, std::memory_order_release);
+        }
+    });
+
+    std::thread consumer([&] {
+        for (long i = 0; i < ITEMS && !exhausted; ++i) {
+            while (tail.load(std::memory_order_relaxed) ==
+                   head.load(std::memory_order_acquire)) {
+                if (exhausted) return;
+                std::this_thread::yield();
+            }
+            Item it = ring[tail % RING];
+            for (size_t j = 0; j < it.size; ++j)
+                if (it.p[j] != static_cast<unsigned char>(i & 0xFF)) corrupt = true;
+            mm_free(it.p);
+            tail.fetch_add(1, std::memory_order_release);
+        }
+    });
+
+    producer.join();
+    consumer.join();
+
+    if (exhausted)
+        return fail(name, "malloc returned nullptr — remotely freed blocks are never reused");
+    if (corrupt)
+        return fail(name, "block contents changed in flight — a block was handed out twice");
+    if (mm_check() != 0)
+        return fail(name, "mm_check() reported heap inconsistency");
+
+    return pass(name);
+}
+
+// Requests up to 256 B come from headerless slab slots: packed tighter
+// than heap blocks, never overlapping, and recycled once freed
+static TestResult test_slab_small() {
+    const std::string name = "Small requests use slab slots";
+    constexpr int N = 2000;
+    static unsigned char *ptrs[N];
+
+    size_t before = mem_heapsize();
+    for (int i = 0; i < N; ++i) {
+        ptrs[i] = static_cast<unsigned char *>(mm_malloc(16));
+        if (ptrs[i] == nullptr)
+            return fail(name, "malloc returned nullptr");
+        if (!is_aligned(ptrs[i]))
+            return fail(name, "returned pointer is not MM_ALIGNMENT-aligned");
+        std::memset(ptrs[i], i & 0xFF, 16);
+    }
+    size_t grown = mem_heapsize() - before;
+
+    // As a heap block, a 16 B request costs a whole minimum-size block:
+    // at least 24 B (32 B at 16-byte alignment). Slab slots have no overhead
+    if (grown >= N * 24)
+        return fail(name, "16 B requests cost as much heap as minimum-size blocks — slab layer not used");
+
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < 16; ++j) {
+            if (ptrs[i][j] != static_cast<unsigned char>(i & 0xFF))
+                return fail(name, "data corruption — two slab slots overlap");
+        }
+    }
+
+    // Freed slots of one class are reused by another: no new pages
+    for (int i = 0; i < N; ++i) mm_free(ptrs[i]);
+    size_t after_free = mem_heapsize();
+    for (int i = 0; i < 64; ++i) {
+        ptrs[i] = static_cast<unsigned char *>(mm_malloc(200));
+        if (ptrs[i] == nullptr)
+            return fail(name, "malloc returned nullptr after freeing every slot");
+    }
+    if (mem_heapsize() != after_free)
+        return fail(name, "heap grew although freed slab runs were available for reuse");
+
+    return pass(name);
+}
+
+// Large requests get their own mapping: the heap does not grow, and
+// realloc keeps the data while the mapping is resized
+static TestResult test_large_mapped() {
+    const std::string name = "Large blocks are mapped outside the heap";
+    size_t before = mem_heapsize();
+
+    auto *p = static_cast<unsigned char *>(mm_malloc(1024 * 1024));
+    if (p == nullptr)
+        return fail(name, "malloc returned nullptr for 1 MB");
+    if (!is_aligned(p))
+        return fail(name, "returned pointer is not MM_ALIGNMENT-aligned");
+    if (mem_heapsize() != before)
+        return fail(name, "1 MB request grew the heap instead of getting its own mapping");
+    std::memset(p, 0x5A, 1000);
+    for (int j = 4096; j < 1024 * 1024; j += 4096) p[j] = static_cast<unsigned char>(j >> 12);
+
+    auto *q = static_cast<unsigned char *>(mm_realloc(p, 6 * 1024 * 1024));
+    if (q == nullptr)
+        return fail(name, "realloc to 6 MB returned nullptr — check mmap_realloc");
+    for (int j = 4096; j < 1024 * 1024; j += 4096) {
+        if (q[j] != static_cast<unsigned char>(j >> 12))
+            return fail(name, "realloc of a mapped block lost its contents");
+    }
+    q[6 * 1024 * 1024 - 1] = 0xAB;
+
+    // Shrinking below the threshold moves the data back into the heap
+    auto *r = static_cast<unsigned char *>(mm_realloc(q, 1000));
+    if (r == nullptr)
+        return fail(name, "realloc from a mapping back to the heap returned nullptr");
+    for (int j = 0; j < 1000; ++j) {
+        if (r[j] != 0x5A)
+            return fail(name, "realloc from a mapping back to the heap lost its contents");
+    }
+    mm_free(r);
+
+    // The whole heap is still available after the mappings are gone
+    void *big = mm_malloc(4 * 1024 * 1024);
+    if (big == nullptr)
+        return fail(name, "4 MB malloc failed after mapped blocks were freed");
+    mm_free(big);
+
+    return pass(name);
+}
+
+// The heap is a reservation committed on demand: it grows well past the
+// old 8 MB limit without moving, and a small cap set at init is honoured
+static TestResult test_heap_reservation() {
+    const std::string name = "Heap grows on demand up to its cap";
+    constexpr int    N    = 120;
+    constexpr size_t SIZE = 100 * 1024;   // below the mmap threshold
+    static unsigned char *ptrs[N];
+
+    void *lo = mem_heap_lo();
+    for (int i = 0; i < N; ++i) {
+        ptrs[i] = static_cast<unsigned char *>(mm_malloc(SIZE));
+        if (ptrs[i] == nullptr)
+            return fail(name, "malloc returned nullptr before the heap reached 12 MB");
+        ptrs[i][0] = ptrs[i][SIZE - 1] = static_cast<unsigned char>(i);
+    }
+    if (mem_heapsize() < N * SIZE || mem_heap_lo() != lo)
+        return fail(name, "heap did not grow in place past 8 MB");
+    for (int i = 0; i < N; ++i) {
+        if (ptrs[i][0] != static_cast<unsigned char>(i) ||
+            ptrs[i][SIZE - 1] != static_cast<unsigned char>(i))
+            return fail(name, "data corruption in a block committed on demand");
+    }
+
+    // With a 1 MB cap the allocator runs dry cleanly and recovers on free
+    mem_deinit();
+    mem_init_max(1024 * 1024);
+    if (mm_init() != 0)
+        return fail(name, "mm_init() failed with a 1 MB heap cap");
+    int got = 0;
+    while (got < N && (ptrs[got] = static_cast<unsigned char *>(mm_malloc(SIZE))) != nullptr) ++got;
+    if (got == 0 || got >= 10)
+        return fail(name, "a 1 MB heap cap did not limit 100 KB allocations to fewer than 10");
+    mm_free(ptrs[0]);
+    if (mm_malloc(SIZE) == nullptr)
+        return fail(name, "malloc failed after freeing a block in a full heap");
+
+    return pass(name);
+}
+
+// Freed memory goes back to the OS: a free tail shrinks the heap, and
+// large free blocks further in lose their physical pages once they have
+// sat unchanged through a purge round
+static TestResult test_release_memory() {
+    const std::string name = "Freed memory is returned to the OS";
+    constexpr int    N    = 40;
+    constexpr int    M    = 30;           // 3 MB of frees: two purge rounds
+    constexpr size_t SIZE = 100 * 1024;   // below the mmap threshold
+    static void *ptrs[N], *others[M], *spacers[M];
+
+    size_t before = mem_heapsize();
+    for (int i = 0; i < N; ++i) {
+        if ((ptrs[i] = mm_malloc(SIZE)) == nullptr)
+            return fail(name, "malloc returned nullptr");
+        std::memset(ptrs[i], 0x77, SIZE);
+    }
+    for (int i = 0; i < N; ++i) mm_free(ptrs[i]);
+    if (mem_heapsize() > before + 128 * 1024)
+        return fail(name, "freeing a 4 MB burst at the end of the heap did not shrink it");
+
+    // Same burst with a live block behind it: the heap cannot shrink, but
+    // the pages in the middle of the merged free block must be purged once
+    // more frees elsewhere (blocks kept apart by live spacers) have run
+    // two purge rounds past it
+    for (int i = 0; i < N; ++i) {
+        if ((ptrs[i] = mm_malloc(SIZE)) == nullptr)
+            return fail(name, "malloc returned nullptr after trimming");
+        std::memset(ptrs[i], 0x77, SIZE);
+    }
+    void *guard = mm_malloc(1000);
+    if (guard == nullptr)
+        return fail(name, "malloc returned nullptr");
+    for (int i = 0; i < M; ++i) {
+        if ((others[i] = mm_malloc(SIZE)) == nullptr || (spacers[i] = mm_malloc(1000)) == nullptr)
+            return fail(name, "malloc returned nullptr");
+    }
+    for (int i = 0; i < N; ++i) mm_free(ptrs[i]);
+    for (int i = 0; i < M; ++i) mm_free(others[i]);
+
+    size_t    page = mem_pagesize();
+    uintptr_t mid  = (reinterpret_cast<uintptr_t>(ptrs[2]) + SIZE / 2) & ~(page - 1);
+    unsigned char resident = 0;
+    if (mincore(reinterpret_cast<void *>(mid), page, &resident) != 0)
+        return fail(name, "mincore failed on a heap page");
+    if (resident & 1)
+        return fail(name, "a page inside a 4 MB free block is still resident — purging did not run");
+
+    return pass(name);
+}
+
+// Returning memory backs off where it would be undone: a heap whose
+// trimmed tail is wanted again trims less eagerly, and a purged block is
+// not purged again until it changes
+static TestResult test_release_backoff() {
+    const std::string name = "Trimming and purging back off under reuse";
+    constexpr int    N    = 10;
+    constexpr int    M    = 30;           // 3 MB of frees: two purge rounds
+    constexpr size_t SIZE = 100 * 1024;   // below the mmap threshold
+    static void *ptrs[N], *others[2][M], *spacers[2][M];
+
+    // A 200 KB tail is trimmed the first time, but once the heap has had
+    // to grow back for it, the threshold has doubled past it
+    void *a = mm_malloc(SIZE), *b = mm_malloc(SIZE);
+    if (a == nullptr || b == nullptr)
+        return fail(name, "malloc returned nullptr");
+    size_t grown = mem_heapsize();
+    mm_free(b);
+    mm_free(a);
+    if (mem_heapsize() + SIZE > grown)
+        return fail(name, "a free 200 KB tail was not trimmed");
+    a = mm_malloc(SIZE);
+    b = mm_malloc(SIZE);
+    if (a == nullptr || b == nullptr)
+        return fail(name, "malloc returned nullptr after trimming");
+    grown = mem_heapsize();
+    mm_free(b);
+    mm_free(a);
+    if (mem_heapsize() != grown)
+        return fail(name, "the heap trimmed again a tail it had just grown back");
+
+    // A 1 MB free block behind a guard is purged after two rounds of frees
+    // elsewhere; a page of it made resident again behind the allocator's
+    // back stays so through two more, as the block has not changed
+    for (int i = 0; i < N; ++i) {
+        if ((ptrs[i] = mm_malloc(SIZE)) == nullptr)
+            return fail(name, "malloc returned nullptr");
+        std::memset(ptrs[i], 0x77, SIZE);
+    }
+    void *guard = mm_malloc(1000);
+    if (guard == nullptr)
+        return fail(name, "malloc returned nullptr");
+    for (int r = 0; r < 2; ++r) {
+        for (int i = 0; i < M; ++i) {
+            if ((others[r][i] = mm_malloc(SIZE)) == nullptr ||
+                (spacers[r][i] = mm_malloc(1000)) == nullptr)
+                return fail(name, "malloc returned nullptr");
+        }
+    }
+
+    size_t    page = mem_pagesize();
+    uintptr_t mid  = (reinterpret_cast<uintptr_t>(ptrs[N / 2]) + SIZE / 2) & ~(page - 1);
+    unsigned char resident = 0;
+    for (int i = 0; i < N; ++i) mm_free(ptrs[i]);
+    if (mincore(reinterpret_cast<void *>(mid), page, &resident) != 0)
+        return fail(name, "mincore failed on a heap page");
+    if (!(resident & 1))
+        return fail(name, "a block was purged before sitting through a round");
+    for (int i = 0; i < M; ++i) mm_free(others[0][i]);
+    if (mincore(reinterpret_cast<void *>(mid), page, &resident) != 0)
+        return fail(name, "mincore failed on a heap page");
+    if (resident & 1)
+        return fail(name, "a 1 MB free block was not purged after two rounds");
+
+    *reinterpret_cast<volatile char *>(mid) = 0;     // Still zero, as purged
+    for (int i = 0; i < M; ++i) mm_free(others[1][i]);
+    if (mincore(reinterpret_cast<void *>(mid), page, &resident) != 0)
+        return fail(name, "mincore failed on a heap page");
+    if (!(resident & 1))
+        return fail(name, "an unchanged purged block was purged again");
+    if (mm_check() != 0)
+        return fail(name, "heap inconsistent after purging");
+
+    for (int r = 0; r < 2; ++r)
+        for (int i = 0; i < M; ++i) mm_free(spacers[r][i]);
+    mm_free(guard);
+    return pass(name);
+}
+
+// mm_get_stats counts mallocs/frees per class, across threads, and
+// reports a heap shape consistent with mem_heapsize
+static TestResult test_stats() {
+    const std::string name = "mm_get_stats reports counts and heap shape";
+    mm_stats st;
+
+    void *small[10], *mid[5];
+    for (auto &p : small) p = mm_malloc(40);           // slab class up to 48 B
+    for (auto &p : mid)   p = mm_malloc(3000);         // heap block up to 4 KB
+    void *big = mm_malloc(1000 * 1000);                // mapped, up to 1 MB
+    for (auto &p : small) if (p == nullptr) return fail(name, "malloc returned nullptr");
+    for (auto &p : mid)   if (p == nullptr) return fail(name, "malloc returned nullptr");
+    if (big == nullptr) return fail(name, "malloc returned nullptr");
+    for (int i = 0; i < 4; ++i) mm_free(small[i]);
+    mm_free(mid[0]);
+
+    // A thread that has already exited must still be counted
+    std::thread t([] { for (int i = 0; i < 100; ++i) mm_free(mm_malloc(40)); });
+    t.join();
+
+    mm_get_stats(&st);
+    int c48 = 0, c4k = 0, c1m = 0;
+    while (st.class_max[c48] < 40)          ++c48;
+    while (st.class_max[c4k] < 3000)        ++c4k;
+    while (st.class_max[c1m] < 1000 * 1000) ++c1m;
+
+    if (st.mallocs[c48] != 110 || st.frees[c48] != 104)
+        return fail(name, "wrong malloc/free counts for the 40 B class");
+    if (st.mallocs[c4k] != 5 || st.frees[c4k] != 1)
+        return fail(name, "wrong malloc/free counts for the 3000 B class");
+    if (st.mallocs[c1m] != 1 || st.frees[c1m] != 0 || st.mapped_bytes < 1000 * 1000)
+        return fail(name, "mapped block not counted");
+    if (st.heap_size != mem_heapsize() || st.extend_heap_calls == 0)
+        return fail(name, "heap size or extend_heap count is off");
+    if (st.free_blocks == 0 || st.largest_free == 0 || st.largest_free > st.bytes_free)
+        return fail(name, "free block figures are inconsistent");
+    if (st.bytes_allocated + st.bytes_free != st.heap_size + st.mapped_bytes)
+        return fail(name, "allocated + free bytes do not add up to the heap size");
+    if (st.fragmentation < 0.0 || st.fragmentation >= 1.0)
+        return fail(name, "fragmentation ratio outside [0, 1)");
+
+    return pass(name);
+}
+
+// mm_get_profile reports nothing unless built with MM_PROFILE; with it,
+// every call is timed and every find_fit search is counted
+static TestResult test_profile() {
+    const std::string name = "mm_get_profile reports search lengths, latency";
+    mm_profile prof;
+
+    void *small[100], *mid[200];
+    for (auto &p : small) p = mm_malloc(40);
+    for (auto &p : mid)   p = mm_malloc(3000);
+    for (auto &p : small) if (p == nullptr) return fail(name, "malloc returned nullptr");
+    for (auto &p : mid)   if (p == nullptr) return fail(name, "malloc returned nullptr");
+    for (auto &p : small) mm_free(p);
+    for (auto &p : mid)   mm_free(p);
+
+    if (mm_get_profile(&prof) != 0) {
+        if (prof.fit_calls != 0 || prof.malloc_calls != 0 || prof.free_calls != 0)
+            return fail(name, "profile compiled out but counts are not zeroed");
+        return pass(name);
+    }
+
+    unsigned long nodes = 0;
+    for (unsigned long n : prof.fit_nodes) nodes += n;
+    if (prof.malloc_calls != 300 || prof.free_calls != 300)
+        return fail(name, "wrong number of timed malloc/free calls");
+    if (prof.fit_calls < 200 || nodes != prof.fit_calls)
+        return fail(name, "find_fit histogram does not cover every heap malloc");
+    if (prof.fit_p50 > prof.fit_p99 || prof.fit_p99 > prof.fit_p999 ||
+        prof.fit_p999 >= MM_FIT_BUCKETS)
+        return fail(name, "find_fit percentiles out of order");
+    if (prof.malloc_p50 == 0 || prof.malloc_p50 > prof.malloc_p99 ||
+        prof.malloc_p99 > prof.malloc_p999 || prof.free_p50 > prof.free_p99 ||
+        prof.free_p99 > prof.free_p999)
+        return fail(name, "latency percentiles out of order");
+
+    return pass(name);
+}
+
+// Under MM_FIT_POLICY=address the lowest-addressed block that fits is
+// reused, not the most recently freed one, and heavy churn through the
+// address tree keeps every block intact
+static TestResult address_order_checks(const std::string &name) {
+    // Above the quick-list sizes, so a defer build frees them at once too
+    void *p[6];
+    for (auto &q : p) if ((q = mm_malloc(2000)) == nullptr) return fail(name, "malloc returned nullptr");
+    mm_free(p[1]);
+    mm_free(p[3]);
+    if (mm_malloc(2000) != p[1])
+        return fail(name, "did not reuse the lowest-addressed free block");
+    mm_free(p[4]);                                   // merges with p[3]
+    if (mm_malloc(3000) != p[3])
+        return fail(name, "did not place a larger request in the merged low block");
+
+    constexpr int N = 128;
+    unsigned char *ptrs[N]  = {};
+    size_t         sizes[N] = {};
+    uint32_t       seed     = 777;
+    for (int step = 0; step < 20000; ++step) {
+        int i = static_cast<int>(next_rand(seed) % N);
+        if (ptrs[i] != nullptr) {
+            if (ptrs[i][0] != static_cast<unsigned char>(i) || ptrs[i][sizes[i] - 1] != static_cast<unsigned char>(i))
+                return fail(name, "data corruption under the address-ordered policy");
+            mm_free(ptrs[i]);
+            ptrs[i] = nullptr;
+        } else {
+            sizes[i] = 300 + next_rand(seed) % 6000;
+            if ((ptrs[i] = static_cast<unsigned char *>(mm_malloc(sizes[i]))) == nullptr)
+                return fail(name, "malloc returned nullptr under the address-ordered policy");
+            std::memset(ptrs[i], i, sizes[i]);
+        }
+    }
+    return pass(name);
+}
+
+static TestResult test_address_order() {
+    const std::string name = "Address-ordered policy reuses low blocks";
+    setenv("MM_FIT_POLICY", "address", 1);
+    TestResult r = reset_allocator() ? address_order_checks(name)
+                                     : fail(name, "mm_init() returned non-zero");
+    unsetenv("MM_FIT_POLICY");
+    return r;
+}
+
+// Under the default best-fit policy a large request takes the smallest
+// block that fits, not the most recently freed one: within its own bin,
+// and when it has to move up a bin, within that bin too
+static TestResult best_fit_checks(const std::string &name) {
+    // a and b share a bin, as do c and d; heap-sized guards keep them apart
+    void *a = mm_malloc(17300), *g1 = mm_malloc(1000);
+    void *b = mm_malloc(16500), *g2 = mm_malloc(1000);
+    void *c = mm_malloc(19500), *g3 = mm_malloc(1000);
+    void *d = mm_malloc(20300), *g4 = mm_malloc(1000);
+    for (void *q : {a, b, c, d, g1, g2, g3, g4})
+        if (q == nullptr) return fail(name, "malloc returned nullptr");
+
+    mm_free(b);
+    mm_free(a);                                      // LIFO would pick a
+    if (mm_malloc(16440) != b)
+        return fail(name, "did not take the smallest fitting block in the bin");
+    mm_free(c);
+    mm_free(d);
+    if (mm_malloc(18000) != c)
+        return fail(name, "did not take the smallest block of the next bin");
+    return pass(name);
+}
+
+static TestResult test_best_fit() {
+    const std::string name = "Best-fit policy takes the tightest large block";
+    setenv("MM_FIT_POLICY", "best", 1);
+    TestResult r = reset_allocator() ? best_fit_checks(name)
+                                     : fail(name, "mm_init() returned non-zero");
+    unsetenv("MM_FIT_POLICY");
+    return r;
+}
+
+// Run fn with stderr sent to /dev/null, so expected mm_check reports
+// do not clutter the test output
+template <typename F>
+static int without_stderr(F fn) {
+    int saved = dup(STDERR_FILENO);
+    int null  = open("/dev/null", O_WRONLY);
+    if (null >= 0) dup2(null, STDERR_FILENO);
+    int result = fn();
+    if (saved >= 0) dup2(saved, STDERR_FILENO);
+    if (null >= 0) close(null);
+    if (saved >= 0) close(saved);
+    return result;
+}
+
+// The incremental check passes after every call of a mixed workload, and
+// both modes catch a free block whose footer was overwritten
+static TestResult test_check_modes() {
+    const std::string name = "mm_check and incremental mode catch corruption";
+    constexpr int N = 128;
+    void    *ptrs[N] = {};
+    uint32_t seed    = 4242;
+
+    for (int step = 0; step < 20000; ++step) {
+        int i = static_cast<int>(next_rand(seed) % N);
+        size_t size = 1 + next_rand(seed) % (next_rand(seed) % 4 == 0 ? 20000 : 600);
+        if (ptrs[i] == nullptr)             ptrs[i] = mm_malloc(size);
+        else if (next_rand(seed) % 3 == 0)  ptrs[i] = mm_realloc(ptrs[i], size);
+        else                                { mm_free(ptrs[i]); ptrs[i] = nullptr; }
+
+        if (mm_check_incremental() != 0)
+            return fail(name, "incremental check failed on a sound heap at step " + std::to_string(step));
+        if (step % 2000 == 0 && mm_check() != 0)
+            return fail(name, "full check failed on a sound heap at step " + std::to_string(step));
+    }
+    for (void *p : ptrs) mm_free(p);
+    if (mm_check() != 0) return fail(name, "full check failed after freeing everything");
+
+    // Above the quick-list sizes, so b gets a footer even in a defer build
+    void *a = mm_malloc(2000), *b = mm_malloc(2000), *c = mm_malloc(2000);
+    if (a == nullptr || b == nullptr || c == nullptr) return fail(name, "malloc returned nullptr");
+    mm_free(b);
+
+    auto       *hdr    = reinterpret_cast<header_word *>(static_cast<char *>(b) - sizeof(header_word));
+    auto       *ftr    = reinterpret_cast<header_word *>(static_cast<char *>(b) + (*hdr & ~header_word(7)) -
+                                                         2 * sizeof(header_word));
+    header_word intact = *ftr;
+    *ftr = intact + 8;
+    if (without_stderr(mm_check_incremental) == 0)
+        return fail(name, "incremental check missed a bad footer on the last freed block");
+    if (without_stderr(mm_check) == 0)
+        return fail(name, "full check missed a bad footer");
+    *ftr = intact;
+    if (mm_check() != 0) return fail(name, "full check failed after the footer was restored");
+
+    mm_free(a);
+    mm_free(c);
+    return pass(name);
+}
+
+static bool all_zero(const void *p, size_t n) {
+    const unsigned char *b = static_cast<const unsigned char *>(p);
+    for (size_t i = 0; i < n; ++i) if (b[i] != 0) return false;
+    return true;
+}
+
+// Every mm_calloc block reads as zero, whether it came from fresh heap
+// pages, from blocks dirtied and freed by a mixed workload, or from a
+// mapping; oversized products are refused
+static TestResult calloc_checks(const std::string &name) {
+    if (mm_calloc(SIZE_MAX / 2, 3) != nullptr || mm_calloc(3, SIZE_MAX / 2) != nullptr)
+        return fail(name, "calloc did not refuse an overflowing nmemb * size");
+    if (mm_calloc(0, 100) != nullptr || mm_calloc(100, 0) != nullptr)
+        return fail(name, "calloc of zero bytes returned a block");
+
+    constexpr int N = 64;
+    static const size_t sizes[] = {24, 100, 400, 3000, 20000, 70000, 300000, 2 << 20};
+    void    *ptrs[N] = {};
+    uint32_t seed    = 777;
+
+    for (int step = 0; step < 3000; ++step) {
+        int i = static_cast<int>(next_rand(seed) % N);
+        if (ptrs[i] != nullptr) {
+            mm_free(ptrs[i]);
+            ptrs[i] = nullptr;
+            continue;
+        }
+        size_t len   = sizes[next_rand(seed) % (sizeof(sizes) / sizeof(sizes[0]))] + next_rand(seed) % 64;
+        bool   clear = next_rand(seed) % 2 == 0;
+        ptrs[i] = clear ? mm_calloc(1, len) : mm_malloc(len);
+        if (ptrs[i] == nullptr) return fail(name, "allocation returned nullptr");
+        if (clear && !all_zero(ptrs[i], len)) return fail(name, "calloc block was not zero");
+        std::memset(ptrs[i], 0xAB, len);              // Dirty it for later reuse
+    }
+    for (void *p : ptrs) mm_free(p);
+    if (mm_check() != 0) return fail(name, "heap inconsistent after the workload");
+    return pass(name);
+}
+
+static TestResult test_calloc() {
+    const std::string name = "mm_calloc zeroes fresh, reused and mapped blocks";
+    TestResult r = calloc_checks(name);
+    if (!r.passed) return r;
+
+    // Again with every block in the heap, so large ones are cleared there
+    setenv("MM_MMAP_THRESHOLD", "0", 1);
+    r = reset_allocator() ? calloc_checks(name) : fail(name, "mm_init() returned non-zero");
+    unsetenv("MM_MMAP_THRESHOLD");
+    return r;
+}
+
+// Aligned blocks of every size path honor their alignment and hold
+// their data; the head cut off to align a block is a reusable free block
+static TestResult test_memalign() {
+    const std::string name = "mm_memalign aligns blocks and reuses the gaps";
+    if (mm_memalign(48, 100) != nullptr || mm_memalign(0, 100) != nullptr ||
+        mm_memalign(64, 0) != nullptr)
+        return fail(name, "bad alignment or zero size was not refused");
+
+    static const size_t aligns[] = {8, 16, 32, 64, 4096, 65536};
+    static const size_t sizes[]  = {1, 100, 1000, 5000, 200000};
+    std::vector<void *> blocks;
+    for (size_t a : aligns) {
+        for (size_t n : sizes) {
+            void *p = (a == 64) ? mm_aligned_alloc(a, n) : mm_memalign(a, n);
+            if (p == nullptr) return fail(name, "memalign returned nullptr");
+            if (reinterpret_cast<uintptr_t>(p) % a != 0)
+                return fail(name, "block is not aligned as requested");
+            std::memset(p, static_cast<int>(n & 0xff), n);
+            blocks.push_back(p);
+        }
+    }
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        size_t n = sizes[i % (sizeof(sizes) / sizeof(sizes[0]))];
+        const unsigned char *b = static_cast<const unsigned char *>(blocks[i]);
+        if (b[0] != (n & 0xff) || b[n - 1] != (n & 0xff))
+            return fail(name, "aligned blocks overlap");
+        mm_free(blocks[i]);
+    }
+    if (mm_check() != 0) return fail(name, "heap inconsistent after aligned blocks");
+
+    // On a fresh heap, page-aligned 2 KB blocks leave a ~2 KB head free
+    // before each one; as many 1.5 KB blocks then fit without growing it
+    if (!reset_allocator()) return fail(name, "mm_init() returned non-zero");
+    void *pages[32], *fill[32];
+    for (auto &p : pages) {
+        if ((p = mm_memalign(4096, 2048)) == nullptr) return fail(name, "memalign returned nullptr");
+    }
+    size_t heap = mem_heapsize();
+    for (auto &p : fill) {
+        if ((p = mm_malloc(1500)) == nullptr) return fail(name, "malloc returned nullptr");
+    }
+    if (mem_heapsize() != heap) return fail(name, "heads cut off for alignment were not reused");
+    for (void *p : pages) mm_free(p);
+    for (void *p : fill)  mm_free(p);
+    return pass(name);
+}
+
+// Every block's usable size covers its request and can be written in
+// full without harming its neighbors, and mm_realloc to that size keeps
+// the block where it is
+static TestResult test_usable_size() {
+    const std::string name = "mm_usable_size reports writable slack";
+    size_t actual = 1;
+    if (mm_usable_size(nullptr) != 0) return fail(name, "usable size of nullptr is not 0");
+    if (mm_malloc_at_least(0, &actual) != nullptr || actual != 0)
+        return fail(name, "zero-byte request did not report 0 bytes");
+    void *plain = mm_malloc_at_least(100, nullptr);
+    if (plain == nullptr) return fail(name, "malloc_at_least without an actual pointer returned nullptr");
+    mm_free(plain);
+
+    static const size_t sizes[] = {1, 17, 100, 250, 257, 300, 500, 1000, 5000, 200000};
+    constexpr int N = sizeof(sizes) / sizeof(sizes[0]);
+    void   *ptrs[N + 1];
+    size_t  usable[N + 1];
+    for (int i = 0; i < N; ++i) {
+        if ((ptrs[i] = mm_malloc_at_least(sizes[i], &usable[i])) == nullptr)
+            return fail(name, "malloc_at_least returned nullptr");
+        if (usable[i] < sizes[i]) return fail(name, "usable size is below the request");
+        if (usable[i] != mm_usable_size(ptrs[i]))
+            return fail(name, "malloc_at_least and usable_size disagree");
+    }
+    if ((ptrs[N] = mm_memalign(4096, 1000)) == nullptr) return fail(name, "memalign returned nullptr");
+    if ((usable[N] = mm_usable_size(ptrs[N])) < 1000) return fail(name, "aligned block's usable size is below the request");
+
+    for (int i = 0; i <= N; ++i) std::memset(ptrs[i], i + 1, usable[i]);
+    for (int i = 0; i <= N; ++i) {
+        const unsigned char *b = static_cast<const unsigned char *>(ptrs[i]);
+        if (b[0] != i + 1 || b[usable[i] - 1] != i + 1)
+            return fail(name, "writing a block's slack clobbered another block");
+        if (mm_realloc(ptrs[i], usable[i]) != ptrs[i])
+            return fail(name, "realloc to the usable size moved the block");
+    }
+    if (mm_check() != 0) return fail(name, "heap inconsistent after filling every block's slack");
+
+    for (void *p : ptrs) mm_free(p);
+    return pass(name);
+}
+
+// Only a deferred-coalescing build (make defer) parks freed blocks;
+// elsewhere they coalesce at once and there is nothing to check
+static TestResult test_defer_coalesce() {
+    const std::string name = "Deferred coalescing parks, reuses, flushes";
+#if defined(MM_DEFER_COALESCE) && MM_DEFER_COALESCE
+    void *a = mm_malloc(1000), *b = mm_malloc(1000), *c = mm_malloc(1000);
+    void *guard = mm_malloc(1000);      // Keeps the blocks above off the heap's end
+    if (a == nullptr || b == nullptr || c == nullptr || guard == nullptr)
+        return fail(name, "malloc returned nullptr");
+    size_t usable = mm_usable_size(a);
+
+    // Use up the rest of the heap, so only merged parked blocks can fit
+    // a request for three blocks' worth
+    mm_stats st;
+    mm_get_stats(&st);
+    void *rest = st.largest_free > 1024 ? mm_malloc(st.largest_free - 64) : nullptr;
+
+    mm_get_stats(&st);
+    size_t free_blocks = st.free_blocks, bytes_free = st.bytes_free;
+    mm_free(a);
+    mm_free(b);
+    mm_free(c);
+    mm_get_stats(&st);
+    if (st.free_blocks != free_blocks || st.bytes_free != bytes_free)
+        return fail(name, "freed blocks were coalesced instead of parked");
+    if (mm_check() != 0) return fail(name, "heap inconsistent with parked blocks");
+
+    // The same size comes straight back off its quick list, last freed first
+    if (mm_malloc(1000) != c || mm_malloc(1000) != b)
+        return fail(name, "parked blocks were not reused");
+    mm_free(b);
+    mm_free(c);
+
+    // No free block fits three: find_fit misses, every parked block is
+    // merged, and the request lands where they were without growing the heap
+    size_t heap = mem_heapsize();
+    void  *big  = mm_malloc(3 * usable);
+    if (big != a) return fail(name, "parked blocks were not merged when find_fit missed");
+    if (mem_heapsize() != heap) return fail(name, "heap grew although the merged blocks fit");
+    if (mm_check() != 0) return fail(name, "heap inconsistent after flushing the quick lists");
+
+    mm_free(big);
+    mm_free(rest);
+    mm_free(guard);
+#endif
+    return pass(name);
+}
+
+static bool in_heap(const void *p) {
+    return p >= mem_heap_lo() && p <= mem_heap_hi();
+}
+
+// With every block in the heap, neighbors totalling more than 4 GB are
+// freed and merged without any block size wrapping around its header
+// word. A request bigger than 4 GB is mapped with 4-byte headers and
+// stays in the heap with 8-byte ones. Only headers are written, so the
+// pages behind these blocks are never touched.
+static TestResult test_huge_blocks() {
+    const std::string name = "Blocks past 4 GB never truncate a header";
+    constexpr size_t GB = size_t(1) << 30;
+    if (mem_maxheap() < 16 * GB) return pass(name);
+
+    setenv("MM_MMAP_THRESHOLD", "0", 1);
+    bool ok = reset_allocator();
+    unsetenv("MM_MMAP_THRESHOLD");
+    if (!ok) return fail(name, "mm_init() returned non-zero");
+
+    void *big[3];
+    for (auto &p : big) {
+        if ((p = mm_malloc(GB + GB / 2)) == nullptr) return fail(name, "malloc of 1.5 GB returned nullptr");
+        if (!in_heap(p)) return fail(name, "1.5 GB block was not placed in the heap");
+    }
+    mm_free(big[1]);
+    mm_free(big[0]);
+    mm_free(big[2]);
+    if (mm_check() != 0) return fail(name, "heap inconsistent after merging 4.5 GB of free blocks");
+
+    void *p = mm_malloc(3 * GB);
+    if (p == nullptr || !in_heap(p)) return fail(name, "3 GB block did not come from the freed space");
+    void *q = mm_malloc(5 * GB);
+    if (q == nullptr) return fail(name, "malloc of 5 GB returned nullptr");
+    if (in_heap(q) != (MM_WIDE_HEADERS != 0))
+        return fail(name, MM_WIDE_HEADERS ? "5 GB block left the heap despite 8-byte headers"
+                                          : "5 GB block was put in the heap behind a 4-byte header");
+    if (mm_check() != 0) return fail(name, "heap inconsistent with 8 GB allocated");
+
+    mm_free(q);
+    mm_free(p);
+    if (mm_check() != 0) return fail(name, "heap inconsistent after freeing everything");
+    return pass(name);
+}
+
+// Run misuse in a forked child with stderr silenced, and tell whether
+// the allocator caught it by aborting
+template <typename F>
+static bool aborts(F misuse) {
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        without_stderr([&] { misuse(); return 0; });
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+// Only a hardened build (make harden) checks pointers; elsewhere these
+// frees are undefined behavior, so the test has nothing to run
+static TestResult test_harden() {
+    const std::string name = "Hardened mode rejects double and invalid frees";
+#if defined(MM_HARDEN) && MM_HARDEN
+    void *guard = mm_malloc(1000);      // Keeps the blocks below off the heap's end
+    if (guard == nullptr) return fail(name, "malloc returned nullptr");
+
+    if (!aborts([] { void *p = mm_malloc(1000); mm_free(p); mm_free(p); }))
+        return fail(name, "double free of a heap block was not caught");
+    if (!aborts([] { void *p = mm_malloc(400); mm_free(p); mm_free(p); }))
+        return fail(name, "double free of a cached heap block was not caught");
+    if (!aborts([] { void *p = mm_malloc(100); mm_free(p); mm_free(p); }))
+        return fail(name, "double free of a slab slot was not caught");
+    if (!aborts([] { char *p = static_cast<char *>(mm_malloc(1000));
+                     std::memset(p, 0, 1000); mm_free(p + 64); }))
+        return fail(name, "free of an interior pointer was not caught");
+    if (!aborts([] { char *p = static_cast<char *>(mm_malloc(100)); mm_free(p + 8); }))
+        return fail(name, "free of a pointer inside a slab slot was not caught");
+    if (!aborts([] { mm_free(reinterpret_cast<void *>(0x1000)); }))
+        return fail(name, "free of a wild pointer was not caught");
+    if (!aborts([] { char *p = static_cast<char *>(mm_malloc(1000));
+                     std::memset(p, 'x', 1001); mm_free(p); }))
+        return fail(name, "one-byte overflow into the seal was not caught");
+    if (!aborts([] { void *p = mm_malloc(1000); mm_free(p); mm_realloc(p, 2000); }))
+        return fail(name, "realloc of a freed block was not caught");
+
+    mm_free(guard);
+#endif
+    return pass(name);
+}
+
+// ─────────────────────────────────────────────
+// Registration + main
+// ─────────────────────────────────────────────
+
+static void register_all() {
+    register_test("free(nullptr) is a no-op",                     test_free_null);
+    register_test("Freed block is reused",                        test_free_reuse);
+    register_test("Adjacent free blocks coalesce",                test_coalesce_neighbors);
+    register_test("malloc/free cycles do not leak",               test_no_leak_cycles);
+    register_test("Random malloc/free pattern",                   test_random_pattern);
+    register_test("realloc grows in place",                       test_realloc_in_place);
+    register_test("realloc preserves data when moving",           test_realloc_copy);
+    register_test("Concurrent malloc/free from 4 threads",        test_threads);
+    register_test("Cross-thread frees with 4 arenas",             test_cross_thread_free);
+    register_test("Producer/consumer pipeline with 2 arenas",     test_pipeline_free);
+    register_test("Small requests use slab slots",                test_slab_small);
+    register_test("Large blocks are mapped outside the heap",     test_large_mapped);
+    register_test("Heap grows on demand up to its cap",           test_heap_reservation);
+    register_test("Freed memory is returned to the OS",           test_release_memory);
+    register_test("mm_get_stats reports counts and heap shape",   test_stats);
+    register_test("mm_get_profile reports search lengths, latency", test_profile);
+    register_test("Address-ordered policy reuses low blocks",     test_address_order);
+    register_test("Best-fit policy takes the tightest large block", test_best_fit);
+    register_test("mm_check and incremental mode catch corruption", test_check_modes);
+    register_test("Hardened mode rejects double and invalid frees", test_harden);
+    register_test("mm_calloc zeroes fresh, reused and mapped blocks", test_calloc);
+    register_test("mm_memalign aligns blocks and reuses the gaps", test_memalign);
+    register_test("Blocks past 4 GB never truncate a header",     test_huge_blocks);
+    register_test("mm_usable_size reports writable slack",        test_usable_size);
+    register_test("Deferred coalescing parks, reuses, flushes",   test_defer_coalesce);
+    register_test("Trimming and purging back off under reuse",    test_release_backoff);
+}
+
+int main(int argc, char *argv[]) {
+    register_all();
+
+    // ── Single-test mode ─────────────────────────────────────────────────────
+    if (argc == 2) {
+        int n = std::stoi(argv[1]);
+        if (n < 1 || n > static_cast<int>(g_tests.size())) {
+            std::cerr << "Test number out of range (1-" << g_tests.size() << ")\n";
+            return 2;
+        }
+        mem_init();
+        if (mm_init() != 0) {
+            std::cerr << "FAIL: mm_init() returned non-zero\n";
+            return 1;
+        }
+        auto &[tname, fn] = g_tests[n - 1];
+        TestResult r = fn();
+        if (r.passed) {
+            std::cout << "PASS: " << tname << "\n";
+            mem_deinit();
+            return 0;
+        } else {
+            std::cout << "FAIL: " << tname << "\n";
+            std::cout << "  Hint: " << r.failure_msg << "\n";
+            mem_deinit();
+            return 1;
+        }
+    }
+
+    // ── Full-suite mode ──────────────────────────────────────────────────────
+    std::cout << "============================================\n";
+    std::cout << "  FINAL TEST SUITE\n";
+    std::cout << "  full allocator API\n";
+    std::cout << "============================================\n\n";
+
+    int passed = 0;
+    int total  = static_cast<int>(g_tests.size());
+
+    for (int i = 0; i < total; ++i) {
+        // Fresh allocator state per test
+        if (!reset_allocator()) {
+            std::cout << "  [" << std::setw(2) << (i + 1) << "] "
+                      << g_tests[i].first << "\n"
+                      << "       FAIL: mm_init() returned non-zero\n";
+            continue;
+        }
+
+        std::cout << "  [" << std::setw(2) << (i + 1) << "] "
+                  << std::left << std::setw(50) << g_tests[i].first;
+
+        TestResult r = g_tests[i].second();
+        if (r.passed) {
+            std::cout << "  PASS\n";
+            ++passed;
+        } else {
+            std::cout << "  FAIL\n";
+            std::cout << "       Hint: " << r.failure_msg << "\n";
+        }
+    }
+
+    std::cout << "\n============================================\n";
+    std::cout << "  Result: " << passed << "/" << total << " tests passed\n";
+    std::cout << "============================================\n";
+
+    mem_deinit();
+    if (passed == total) {
+        std::cout << "\nAll final tests passed!\n";
+        return 0;
+    } else {
+        std::cout << "\nSome tests failed — keep debugging!\n"
+                  << "Run  ./test_final <N>  to isolate a single test.\n";
+        return 1;
+    }
+}